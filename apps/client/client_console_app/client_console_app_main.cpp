@@ -1,6 +1,9 @@
 #include <future>
 #include <thread>
 #include <chrono>
+#include <memory>
+#include <string>
+#include <iostream>
 
 #include "configs/cmake_config.h"
 
@@ -8,6 +11,7 @@
 #define ELPP_THREAD_SAFE
 
 #include "dummy_client/dummy_client.hpp"
+#include "load_generator/load_generator.hpp"
 
 INITIALIZE_EASYLOGGINGPP
 
@@ -48,7 +52,40 @@ void wait_for_user_command(dummy::client::Client &client)
     }
 }
 
-int main()
+int run_load_generator()
+{
+    // Shared with the thread waiting for the user, it can outlive the load
+    const auto kGenerator = std::make_shared<load::client::Generator>();
+
+    try
+    {
+        const auto kConfig = load::client::Generator::Config::load_config(
+            CMAKE_CURRENT_SOURCE_DIR + std::string{"/configs/load_config.json"});
+
+        // Any line from the user finishes the load earlier
+        std::thread user_command_thread([kGenerator]()
+                                        {
+                                            std::string input;
+                                            getline(std::cin, input);
+                                            kGenerator->stop(); });
+        user_command_thread.detach();
+
+        if (!kGenerator->run(kConfig))
+        {
+            LOG(ERROR) << "Can't run load generator";
+            return -1;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        LOG(ERROR) << e.what();
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
 {
     try
     {
@@ -58,6 +95,12 @@ int main()
         LOG(INFO) << PROJECT_NAME;
         LOG(INFO) << "version " << PROJECT_VERSION;
 
+        if ((argc > 1) && (std::string(argv[1]) == "--load"))
+        {
+            LOG(INFO) << "Load generator mode, the server has to run with --echo";
+            exit(run_load_generator());
+        }
+
         std::promise<void> client_promise;
         auto client_future = client_promise.get_future();
 
@@ -0,0 +1,3 @@
+#define PROJECT_NAME "client_console_app"
+#define PROJECT_VERSION "0.0.0"
+#define CMAKE_CURRENT_SOURCE_DIR "/root/repo/apps/client/client_console_app"
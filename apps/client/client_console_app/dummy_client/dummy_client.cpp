@@ -27,7 +27,7 @@ namespace dummy
 
             void start_communication();
 
-            void receive(const std::string &data);
+            void receive(const std::string_view &data, const bool &is_binary);
 
         private:
             std::unique_ptr<network_module::client::Client> network_module_;
@@ -86,7 +86,7 @@ namespace dummy
             config.callbacks_.signal_to_stop_ = std::bind(&Client::ClientImpl::process_signal_to_stop, this);
 
             config.callbacks_.on_start_ = std::bind(&Client::ClientImpl::start_communication, this);
-            config.callbacks_.process_receiving_ = std::bind(&Client::ClientImpl::receive, this, std::placeholders::_1);
+            config.callbacks_.process_receiving_ = std::bind(&Client::ClientImpl::receive, this, std::placeholders::_1, std::placeholders::_2);
         }
 
         void Client::ClientImpl::process_signal_to_stop()
@@ -115,8 +115,14 @@ namespace dummy
             return network_module_->send(data);
         }
 
-        void Client::ClientImpl::receive(const std::string &data)
+        void Client::ClientImpl::receive(const std::string_view &data, const bool &is_binary)
         {
+            if (is_binary)
+            {
+                LOG(INFO) << "Received " << data.size() << " bytes of binary data";
+                return;
+            }
+
             LOG(INFO) << "Received data: " << data;
         }
     }
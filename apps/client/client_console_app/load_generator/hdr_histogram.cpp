@@ -0,0 +1,167 @@
+#include "hdr_histogram.hpp"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+namespace
+{
+    int get_leading_zeros(std::uint64_t value)
+    {
+        int zeros = 64;
+        while (value)
+        {
+            value >>= 1;
+            --zeros;
+        }
+
+        return zeros;
+    }
+}
+
+HdrHistogram::HdrHistogram(const std::int64_t &highest_trackable_value,
+                           const int &significant_figures)
+    : kHighestTrackableValue_(std::max<std::int64_t>(highest_trackable_value, 2))
+{
+    const int kSignificantFigures = std::clamp(significant_figures, 1, 5);
+
+    // Values up to it are kept exactly, it fits the sub-buckets of the first bucket
+    const std::int64_t kLargestValueWithSingleUnitResolution = 2 * static_cast<std::int64_t>(std::pow(10, kSignificantFigures));
+    const int kSubBucketCountMagnitude = static_cast<int>(std::ceil(std::log2(static_cast<double>(kLargestValueWithSingleUnitResolution))));
+
+    sub_bucket_half_count_magnitude_ = std::max(kSubBucketCountMagnitude, 1) - 1;
+    sub_bucket_count_ = std::int64_t(1) << (sub_bucket_half_count_magnitude_ + 1);
+    sub_bucket_half_count_ = sub_bucket_count_ / 2;
+    sub_bucket_mask_ = sub_bucket_count_ - 1;
+
+    std::int64_t smallest_untrackable_value = sub_bucket_count_;
+    bucket_count_ = 1;
+    while (smallest_untrackable_value <= kHighestTrackableValue_)
+    {
+        if (smallest_untrackable_value > std::numeric_limits<std::int64_t>::max() / 2)
+        {
+            ++bucket_count_;
+            break;
+        }
+
+        smallest_untrackable_value <<= 1;
+        ++bucket_count_;
+    }
+
+    counts_.assign(static_cast<std::size_t>((bucket_count_ + 1) * sub_bucket_half_count_), 0);
+}
+
+void HdrHistogram::record(std::int64_t value)
+{
+    value = std::clamp<std::int64_t>(value, 0, kHighestTrackableValue_);
+
+    ++counts_[get_counts_index(value)];
+
+    min_ = (total_count_ == 0) ? value : std::min(min_, value);
+    max_ = std::max(max_, value);
+    sum_ += value;
+    ++total_count_;
+}
+
+void HdrHistogram::add(const HdrHistogram &other)
+{
+    if (other.total_count_ == 0)
+        return;
+
+    // Same layout, counts are added index by index
+    for (std::size_t index = 0; index < std::min(counts_.size(), other.counts_.size()); ++index)
+        counts_[index] += other.counts_[index];
+
+    min_ = (total_count_ == 0) ? other.min_ : std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+    sum_ += other.sum_;
+    total_count_ += other.total_count_;
+}
+
+void HdrHistogram::reset()
+{
+    std::fill(counts_.begin(), counts_.end(), 0);
+    total_count_ = 0;
+    min_ = 0;
+    max_ = 0;
+    sum_ = 0;
+}
+
+std::uint64_t HdrHistogram::get_total_count() const
+{
+    return total_count_;
+}
+
+std::int64_t HdrHistogram::get_min() const
+{
+    return min_;
+}
+
+std::int64_t HdrHistogram::get_max() const
+{
+    return max_;
+}
+
+double HdrHistogram::get_mean() const
+{
+    return (total_count_ == 0) ? 0 : sum_ / total_count_;
+}
+
+std::int64_t HdrHistogram::get_value_at_percentile(const double &percentile) const
+{
+    if (total_count_ == 0)
+        return 0;
+
+    const double kPercentile = std::clamp(percentile, 0.0, 100.0);
+    const std::uint64_t kCountAtPercentile =
+        std::max<std::uint64_t>(static_cast<std::uint64_t>(kPercentile / 100 * total_count_ + 0.5), 1);
+
+    std::uint64_t count = 0;
+    for (std::size_t index = 0; index < counts_.size(); ++index)
+    {
+        count += counts_[index];
+        if (count >= kCountAtPercentile)
+            return std::min(get_highest_equivalent_value(get_value_from_index(index)), max_);
+    }
+
+    return max_;
+}
+
+std::size_t HdrHistogram::get_counts_index(const std::int64_t &value) const
+{
+    const int kPow2Ceiling = 64 - get_leading_zeros(static_cast<std::uint64_t>(value | sub_bucket_mask_));
+    const int kBucketIndex = kPow2Ceiling - (sub_bucket_half_count_magnitude_ + 1);
+    const std::int64_t kSubBucketIndex = value >> kBucketIndex;
+
+    return static_cast<std::size_t>(((std::int64_t(kBucketIndex) + 1) << sub_bucket_half_count_magnitude_) +
+                                    (kSubBucketIndex - sub_bucket_half_count_));
+}
+
+std::int64_t HdrHistogram::get_value_from_index(const std::size_t &index) const
+{
+    int bucket_index = static_cast<int>(index >> sub_bucket_half_count_magnitude_) - 1;
+    std::int64_t sub_bucket_index = static_cast<std::int64_t>(index & (sub_bucket_half_count_ - 1)) + sub_bucket_half_count_;
+
+    if (bucket_index < 0)
+    {
+        sub_bucket_index -= sub_bucket_half_count_;
+        bucket_index = 0;
+    }
+
+    return sub_bucket_index << bucket_index;
+}
+
+std::int64_t HdrHistogram::get_highest_equivalent_value(const std::int64_t &value) const
+{
+    const std::size_t kIndex = get_counts_index(value);
+
+    int bucket_index = static_cast<int>(kIndex >> sub_bucket_half_count_magnitude_) - 1;
+    if (bucket_index < 0)
+        bucket_index = 0;
+
+    // Values of one sub-bucket differ in the bits below the bucket index
+    const std::int64_t kRangeSize = std::int64_t(1) << bucket_index;
+    const std::int64_t kLowestEquivalentValue = (value >> bucket_index) << bucket_index;
+
+    return kLowestEquivalentValue + kRangeSize - 1;
+}
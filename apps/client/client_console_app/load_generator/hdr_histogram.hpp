@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+// High dynamic range histogram of integer values. Buckets are powers of two,
+// each split in linear sub-buckets, so any recorded value is kept with the
+// given number of significant decimal digits while the memory depends only
+// on the range, not on the number of values. Layout of HdrHistogram_c
+class HdrHistogram
+{
+public:
+    HdrHistogram() = delete;
+    HdrHistogram(const std::int64_t &highest_trackable_value,
+                 const int &significant_figures = 3);
+    ~HdrHistogram() = default;
+
+    // Values above the highest trackable one are recorded as it
+    void record(std::int64_t value);
+    void add(const HdrHistogram &other);
+    void reset();
+
+    std::uint64_t get_total_count() const;
+    std::int64_t get_min() const;
+    std::int64_t get_max() const;
+    double get_mean() const;
+
+    // Percentile in [0, 100], the highest value equivalent to the recorded one
+    std::int64_t get_value_at_percentile(const double &percentile) const;
+
+private:
+    std::size_t get_counts_index(const std::int64_t &value) const;
+    std::int64_t get_value_from_index(const std::size_t &index) const;
+    std::int64_t get_highest_equivalent_value(const std::int64_t &value) const;
+
+private:
+    const std::int64_t kHighestTrackableValue_;
+
+    int sub_bucket_half_count_magnitude_{0};
+    std::int64_t sub_bucket_count_{0};
+    std::int64_t sub_bucket_half_count_{0};
+    std::int64_t sub_bucket_mask_{0};
+    int bucket_count_{0};
+
+    std::vector<std::uint64_t> counts_;
+    std::uint64_t total_count_{0};
+    std::int64_t min_{0};
+    std::int64_t max_{0};
+    double sum_{0};
+};
@@ -0,0 +1,454 @@
+#include "load_generator.hpp"
+
+#include <mutex>
+#include <chrono>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <charconv>
+#include <algorithm>
+
+#include "easylogging++.h"
+
+#include "json.hpp"
+
+#include "network_module.hpp"
+#include "hdr_histogram.hpp"
+
+namespace
+{
+    const std::string kFixedDistribution{"fixed"};
+    const std::string kUniformDistribution{"uniform"};
+    const std::string kExponentialDistribution{"exponential"};
+
+    load::client::Generator::Config::SizeDistribution parse_size_distribution(const std::string &distribution)
+    {
+        typedef load::client::Generator::Config::SizeDistribution SizeDistribution;
+
+        if (distribution == kFixedDistribution)
+            return SizeDistribution::kFixed;
+
+        if (distribution == kUniformDistribution)
+            return SizeDistribution::kUniform;
+
+        if (distribution == kExponentialDistribution)
+            return SizeDistribution::kExponential;
+
+        const std::string kErrorText{"Unknown message_size_distribution \"" + distribution + "\""};
+        LOG(ERROR) << kErrorText;
+        throw std::runtime_error(kErrorText);
+    }
+
+    // Every message starts with its sending time, the echo brings it back
+    const char kTimeSeparator{'|'};
+
+    // Round trips are recorded in microseconds up to a minute
+    const std::int64_t kHighestLatencyUs{60 * 1000 * 1000};
+
+    // Time given to the answers of the last messages
+    const std::chrono::seconds kDrainTimeout{5};
+
+    std::int64_t get_now_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    std::string format_latencies(const HdrHistogram &histogram)
+    {
+        std::ostringstream stream;
+        stream << "p50 " << histogram.get_value_at_percentile(50)
+               << " us, p99 " << histogram.get_value_at_percentile(99)
+               << " us, p999 " << histogram.get_value_at_percentile(99.9)
+               << " us, max " << histogram.get_max() << " us";
+        return stream.str();
+    }
+}
+
+namespace load
+{
+    namespace client
+    {
+        Generator::Config Generator::Config::load_config(const std::string &config_path)
+        {
+            nlohmann::json json_object;
+            json_object["host"] = "127.0.0.1";
+            json_object["port"] = 8080;
+            json_object["workers_number"] = 4;
+            json_object["connections_number"] = 1000;
+            json_object["connecting_timeout_sec"] = 10;
+            json_object["messages_per_sec"] = 10000;
+            json_object["duration_sec"] = 30;
+            json_object["report_interval_sec"] = 1;
+            json_object["message_size_distribution"] = kUniformDistribution;
+            json_object["message_min_size"] = 64;
+            json_object["message_max_size"] = 1024;
+
+            std::fstream file(config_path);
+            if (!file.is_open())
+            {
+                LOG(DEBUG) << "Creating default config...";
+
+                std::ofstream default_config_file(config_path);
+                if (!default_config_file.is_open())
+                {
+                    const std::string kErrorText{"Can't save default config to \"" + config_path + "\""};
+                    LOG(ERROR) << kErrorText;
+                    throw std::runtime_error(kErrorText);
+                }
+
+                default_config_file << json_object.dump(4);
+                default_config_file.close();
+
+                LOG(DEBUG) << "Created";
+            }
+            else
+            {
+                json_object = nlohmann::json::parse(file);
+                file.close();
+            }
+
+            LOG(DEBUG) << "Current config: \n"
+                       << json_object.dump(4);
+
+            Config config;
+            config.host_ = json_object.value("host", config.host_);
+            config.port_ = json_object.value("port", config.port_);
+            config.workers_number_ = json_object.value("workers_number", config.workers_number_);
+            config.connections_number_ = json_object.value("connections_number", config.connections_number_);
+            config.connecting_timeout_sec_ = json_object.value("connecting_timeout_sec", config.connecting_timeout_sec_);
+            config.messages_per_sec_ = json_object.value("messages_per_sec", config.messages_per_sec_);
+            config.duration_sec_ = json_object.value("duration_sec", config.duration_sec_);
+            config.report_interval_sec_ = json_object.value("report_interval_sec", config.report_interval_sec_);
+            config.size_distribution_ = parse_size_distribution(json_object.value("message_size_distribution", kUniformDistribution));
+            config.min_message_size_ = json_object.value("message_min_size", config.min_message_size_);
+            config.max_message_size_ = json_object.value("message_max_size", config.max_message_size_);
+
+            return config;
+        }
+    }
+}
+
+namespace load
+{
+    namespace client
+    {
+        class Generator::GeneratorImpl
+        {
+        public:
+            GeneratorImpl() = default;
+            ~GeneratorImpl() = default;
+
+            bool run(const Config &config);
+            void stop() noexcept;
+
+        private:
+            bool connect(const Config &config);
+            void send_messages(const Config &config);
+            void wait_for_answers();
+            void receive(const std::string_view &data);
+
+            std::size_t get_message_size(const Config &config);
+            void report(const Config &config, const std::chrono::duration<double> &interval);
+            void report_total(const Config &config, const std::chrono::duration<double> &duration);
+
+        private:
+            std::unique_ptr<network_module::client::Client> network_module_;
+
+            std::atomic_bool is_stopped_{false};
+
+            std::atomic<std::uint64_t> sent_number_{0};
+            std::atomic<std::uint64_t> sent_bytes_{0};
+            std::atomic<std::uint64_t> failed_number_{0};
+            std::atomic<std::uint64_t> received_number_{0};
+
+            // Answers come on the threads of the network module
+            std::mutex histogram_mutex_;
+            HdrHistogram interval_histogram_{kHighestLatencyUs};
+            HdrHistogram total_histogram_{kHighestLatencyUs};
+
+            std::uint64_t reported_sent_number_{0};
+            std::uint64_t reported_received_number_{0};
+
+            std::mt19937_64 random_engine_{std::random_device{}()};
+            std::string message_;
+        };
+
+        bool Generator::GeneratorImpl::run(const Config &config)
+        {
+            LOG(INFO) << "Load: " << config.connections_number_ << " connections on "
+                      << config.workers_number_ << " threads, " << config.messages_per_sec_
+                      << " messages/s for " << config.duration_sec_ << " s";
+
+            if (config.min_message_size_ > config.max_message_size_)
+            {
+                LOG(ERROR) << "message_min_size is bigger than message_max_size";
+                return false;
+            }
+
+            is_stopped_ = false;
+
+            if (!connect(config))
+            {
+                network_module_.reset();
+                return false;
+            }
+
+            const auto kBegin = std::chrono::steady_clock::now();
+            send_messages(config);
+            wait_for_answers();
+            const auto kEnd = std::chrono::steady_clock::now();
+
+            network_module_->stop();
+            network_module_.reset();
+
+            report_total(config, kEnd - kBegin);
+            return true;
+        }
+
+        void Generator::GeneratorImpl::stop() noexcept
+        {
+            is_stopped_ = true;
+        }
+
+        bool Generator::GeneratorImpl::connect(const Config &config)
+        {
+            network_module::client::Client::Config client_config;
+            client_config.host_ = config.host_;
+            client_config.port_ = config.port_;
+            client_config.workers_number_ = config.workers_number_;
+            client_config.connections_number_ = config.connections_number_;
+            client_config.balancing_ = network_module::client::Client::Config::Balancing::kRoundRobin;
+            client_config.callbacks_.process_receiving_ = [this](const std::string_view &data, const bool &)
+            { receive(data); };
+
+            network_module_ = std::make_unique<network_module::client::Client>();
+            if (!network_module_->start(client_config))
+                return false;
+
+            const auto kDeadline = std::chrono::steady_clock::now() + std::chrono::seconds(config.connecting_timeout_sec_);
+            while ((network_module_->get_connected_number() < static_cast<std::size_t>(config.connections_number_)) &&
+                   (std::chrono::steady_clock::now() < kDeadline) &&
+                   !is_stopped_)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+
+            const std::size_t kConnectedNumber = network_module_->get_connected_number();
+            LOG(INFO) << "Connected " << kConnectedNumber << " of " << config.connections_number_;
+
+            if (kConnectedNumber == 0)
+            {
+                LOG(ERROR) << "No connection to the server";
+                network_module_->stop();
+                return false;
+            }
+
+            return true;
+        }
+
+        void Generator::GeneratorImpl::send_messages(const Config &config)
+        {
+            // Messages due by the elapsed time are sent every tick, a late tick catches up
+            const std::chrono::milliseconds kTick{1};
+            const std::chrono::seconds kReportInterval{std::max(config.report_interval_sec_, 1)};
+
+            const auto kBegin = std::chrono::steady_clock::now();
+            const auto kEnd = kBegin + std::chrono::seconds(config.duration_sec_);
+
+            // Messages carry the time they were due, not the time they went out,
+            // so a stall of this thread or of send counts in the round trips
+            const std::int64_t kBeginNs = std::chrono::duration_cast<std::chrono::nanoseconds>(kBegin.time_since_epoch()).count();
+            const double kIntervalNs = 1e9 / std::max(config.messages_per_sec_, 1);
+            auto next_report = kBegin + kReportInterval;
+            auto previous_report = kBegin;
+
+            std::uint64_t due_number = 0;
+            auto now = kBegin;
+            while ((now < kEnd) && !is_stopped_)
+            {
+                const std::chrono::duration<double> kElapsed = now - kBegin;
+                const std::uint64_t kDueNumber = static_cast<std::uint64_t>(kElapsed.count() * config.messages_per_sec_);
+
+                for (; due_number < kDueNumber; ++due_number)
+                {
+                    const std::size_t kSize = get_message_size(config);
+
+                    message_ = std::to_string(kBeginNs + static_cast<std::int64_t>(due_number * kIntervalNs));
+                    message_ += kTimeSeparator;
+                    if (message_.size() < kSize)
+                        message_.append(kSize - message_.size(), 'x');
+
+                    if (network_module_->send(message_))
+                    {
+                        ++sent_number_;
+                        sent_bytes_ += message_.size();
+                    }
+                    else
+                    {
+                        ++failed_number_;
+                    }
+                }
+
+                if (now >= next_report)
+                {
+                    report(config, now - previous_report);
+                    previous_report = now;
+                    next_report += kReportInterval;
+                }
+
+                std::this_thread::sleep_for(kTick);
+                now = std::chrono::steady_clock::now();
+            }
+        }
+
+        void Generator::GeneratorImpl::wait_for_answers()
+        {
+            const auto kDeadline = std::chrono::steady_clock::now() + kDrainTimeout;
+            while ((received_number_ < sent_number_) &&
+                   (std::chrono::steady_clock::now() < kDeadline) &&
+                   !is_stopped_)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        }
+
+        void Generator::GeneratorImpl::receive(const std::string_view &data)
+        {
+            const auto kNow = get_now_ns();
+
+            const auto kSeparator = data.find(kTimeSeparator);
+            if (kSeparator == std::string_view::npos)
+                return;
+
+            std::int64_t sending_time = 0;
+            if (std::from_chars(data.data(), data.data() + kSeparator, sending_time).ec != std::errc())
+                return;
+
+            ++received_number_;
+
+            std::lock_guard<std::mutex> lock(histogram_mutex_);
+            interval_histogram_.record((kNow - sending_time) / 1000);
+        }
+
+        std::size_t Generator::GeneratorImpl::get_message_size(const Config &config)
+        {
+            switch (config.size_distribution_)
+            {
+            case Config::SizeDistribution::kFixed:
+                return config.max_message_size_;
+
+            case Config::SizeDistribution::kExponential:
+            {
+                // Sizes above the maximum are drawn again instead of being clamped,
+                // clamping would pile them up at exactly max_message_size_
+                const double kMeanExcess = std::max((config.max_message_size_ - config.min_message_size_) / 2.0, 1.0);
+                std::exponential_distribution<double> distribution(1 / kMeanExcess);
+
+                while (true)
+                {
+                    const double kSize = config.min_message_size_ + distribution(random_engine_);
+                    if (kSize <= config.max_message_size_)
+                        return static_cast<std::size_t>(kSize);
+                }
+            }
+
+            case Config::SizeDistribution::kUniform:
+            default:
+            {
+                std::uniform_int_distribution<std::size_t> distribution(config.min_message_size_, config.max_message_size_);
+                return distribution(random_engine_);
+            }
+            }
+        }
+
+        void Generator::GeneratorImpl::report(const Config &config, const std::chrono::duration<double> &interval)
+        {
+            const std::uint64_t kSentNumber = sent_number_;
+            const std::uint64_t kReceivedNumber = received_number_;
+
+            std::string latencies;
+            {
+                std::lock_guard<std::mutex> lock(histogram_mutex_);
+                latencies = format_latencies(interval_histogram_);
+                total_histogram_.add(interval_histogram_);
+                interval_histogram_.reset();
+            }
+
+            const double kSeconds = std::max(interval.count(), 1e-9);
+            LOG(INFO) << std::fixed << std::setprecision(0)
+                      << "sent " << (kSentNumber - reported_sent_number_) / kSeconds << "/s"
+                      << ", received " << (kReceivedNumber - reported_received_number_) / kSeconds << "/s"
+                      << ", connected " << network_module_->get_connected_number() << "/" << config.connections_number_
+                      << ", " << latencies;
+
+            reported_sent_number_ = kSentNumber;
+            reported_received_number_ = kReceivedNumber;
+        }
+
+        void Generator::GeneratorImpl::report_total(const Config &config, const std::chrono::duration<double> &duration)
+        {
+            std::lock_guard<std::mutex> lock(histogram_mutex_);
+            total_histogram_.add(interval_histogram_);
+            interval_histogram_.reset();
+
+            const double kSeconds = std::max(duration.count(), 1e-9);
+            const std::uint64_t kSentNumber = sent_number_;
+            const std::uint64_t kReceivedNumber = received_number_;
+
+            LOG(INFO) << "================================";
+            LOG(INFO) << "Connections: " << config.connections_number_ << ", threads: " << config.workers_number_;
+            LOG(INFO) << std::fixed << std::setprecision(1)
+                      << "Sent: " << kSentNumber << " messages, " << sent_bytes_ / (1024.0 * 1024.0) << " MB"
+                      << ", failed to send: " << failed_number_;
+            LOG(INFO) << std::fixed << std::setprecision(1)
+                      << "Received: " << kReceivedNumber << " messages, lost: "
+                      << ((kSentNumber > kReceivedNumber) ? (kSentNumber - kReceivedNumber) : 0);
+            LOG(INFO) << std::fixed << std::setprecision(1)
+                      << "Throughput: " << kReceivedNumber / kSeconds << " messages/s, "
+                      << sent_bytes_ / (1024.0 * 1024.0) / kSeconds << " MB/s sent";
+            LOG(INFO) << std::fixed << std::setprecision(1)
+                      << "Round trip: min " << total_histogram_.get_min()
+                      << " us, mean " << total_histogram_.get_mean()
+                      << " us, p90 " << total_histogram_.get_value_at_percentile(90) << " us";
+            LOG(INFO) << "Round trip: " << format_latencies(total_histogram_);
+        }
+    }
+}
+
+namespace load
+{
+    namespace client
+    {
+        Generator::Generator() : generator_impl_(std::make_unique<GeneratorImpl>()) {}
+
+        Generator::~Generator() {}
+
+        bool Generator::run(const Config &config)
+        {
+            if (!generator_impl_)
+            {
+                static const std::string kErrorText("Implementation is not created");
+                LOG(ERROR) << kErrorText;
+                throw std::runtime_error(kErrorText);
+            }
+
+            return generator_impl_->run(config);
+        }
+
+        void Generator::stop() noexcept
+        {
+            if (!generator_impl_)
+            {
+                LOG(ERROR) << "Implementation is not created";
+                return;
+            }
+
+            generator_impl_->stop();
+        }
+    }
+}
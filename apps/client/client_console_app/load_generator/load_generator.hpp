@@ -0,0 +1,56 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+namespace load
+{
+    namespace client
+    {
+        // Opens many websocket connections on a few threads, sends at a fixed
+        // rate and measures the round trip of every message, the server has to
+        // send messages back to their sender (server_console_app --echo)
+        class Generator
+        {
+        public:
+            struct Config
+            {
+                static Config load_config(const std::string &config_path);
+
+                std::string host_{"127.0.0.1"};
+                int port_{8080};
+
+                int workers_number_{4};
+                int connections_number_{1000};
+                int connecting_timeout_sec_{10};
+
+                int messages_per_sec_{10000}; // All connections together
+                int duration_sec_{30};
+                int report_interval_sec_{1};
+
+                enum class SizeDistribution
+                {
+                    kFixed,      // Always max_message_size_
+                    kUniform,    // Between min_message_size_ and max_message_size_
+                    kExponential // min_message_size_ plus an exponential with a mean of half
+                                 // the range, sizes above max_message_size_ are drawn again
+                } size_distribution_{SizeDistribution::kUniform};
+                std::size_t min_message_size_{64};
+                std::size_t max_message_size_{1024};
+            };
+
+        public:
+            Generator();
+            ~Generator();
+
+            // Blocks for duration_sec_ or until stop, reports are logged
+            bool run(const Config &config);
+            // Can be called from any thread
+            void stop() noexcept;
+
+        private:
+            class GeneratorImpl;
+            std::unique_ptr<GeneratorImpl> generator_impl_;
+        };
+    }
+}
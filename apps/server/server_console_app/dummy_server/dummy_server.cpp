@@ -18,7 +18,8 @@ namespace dummy
 
             bool start(const int workers_number,
                        const std::string &config_path,
-                       const std::string &html_folder_path);
+                       const std::string &html_folder_path,
+                       const bool is_echo_enabled);
             void stop() noexcept;
 
             bool send(const std::string &data);
@@ -27,8 +28,8 @@ namespace dummy
             void configureCallbacks(network_module::server::Server::Config &config);
 
             void process_signal_to_stop();
-            void process_new_websocket_connection();
-            void process_receiving(const std::string &data);
+            void process_new_websocket_connection(const network_module::web_sockets::SessionId &session_id);
+            void process_receiving(const network_module::web_sockets::SessionId &session_id, const std::string_view &data, const bool &is_binary);
 
         private:
             std::unique_ptr<network_module::server::Server> network_module_;
@@ -36,6 +37,8 @@ namespace dummy
 
             std::atomic_bool is_stop_signal_called_{false};
             std::promise<void> signal_to_stop_;
+
+            bool is_echo_enabled_{false};
         };
 
         Server::ServerImpl::ServerImpl(std::promise<void> signal_to_stop)
@@ -48,10 +51,13 @@ namespace dummy
 
         bool Server::ServerImpl::start(const int workers_number,
                                        const std::string &config_path,
-                                       const std::string &html_folder_path)
+                                       const std::string &html_folder_path,
+                                       const bool is_echo_enabled)
         {
             LOG(INFO) << "Starting...";
 
+            is_echo_enabled_ = is_echo_enabled;
+
             network_module_.reset(new network_module::server::Server());
             if (!network_module_)
             {
@@ -82,14 +88,14 @@ namespace dummy
         {
             LOG(INFO) << "Stopping...";
 
-            pages_manager_.reset();
-
             if (network_module_)
             {
                 network_module_->stop();
             }
             network_module_.reset();
 
+            pages_manager_.reset();
+
             LOG(INFO) << "Stopped";
         }
 
@@ -103,20 +109,20 @@ namespace dummy
 
             // Html callbacks
             {
-                config.callbacks_.http_callbacks_["/"] = [&]()
+                config.callbacks_.http_content_callbacks_["/"] = [&]()
                 { return pages_manager_->getHomePage(); };
 
-                config.callbacks_.http_callbacks_["/kek"] = [&]()
+                config.callbacks_.http_content_callbacks_["/kek"] = [&]()
                 { return pages_manager_->getKekPage(); };
 
-                config.callbacks_.http_callbacks_[network_module::Urls::kPageNotFound_] = [&]()
+                config.callbacks_.http_content_callbacks_[network_module::Urls::kPageNotFound_] = [&]()
                 { return pages_manager_->getPageNotFoundPage(); };
             }
 
             // Websockets
             {
-                config.callbacks_.web_sockets_callbacks_.process_new_connection_ = std::bind(&Server::ServerImpl::process_new_websocket_connection, this);
-                config.callbacks_.web_sockets_callbacks_.process_receiving_ = std::bind(&Server::ServerImpl::process_receiving, this, std::placeholders::_1);
+                config.callbacks_.web_sockets_callbacks_.process_new_connection_ = std::bind(&Server::ServerImpl::process_new_websocket_connection, this, std::placeholders::_1);
+                config.callbacks_.web_sockets_callbacks_.process_receiving_ = std::bind(&Server::ServerImpl::process_receiving, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
             }
         }
 
@@ -129,14 +135,27 @@ namespace dummy
             signal_to_stop_.set_value();
         }
 
-        void Server::ServerImpl::process_new_websocket_connection()
+        void Server::ServerImpl::process_new_websocket_connection(const network_module::web_sockets::SessionId &session_id)
         {
-            LOG(INFO) << "New websocket connection";
+            LOG(INFO) << "New websocket connection " << session_id;
         }
 
-        void Server::ServerImpl::process_receiving(const std::string &data)
+        void Server::ServerImpl::process_receiving(const network_module::web_sockets::SessionId &session_id, const std::string_view &data, const bool &is_binary)
         {
-            LOG(INFO) << "Received: " << data;
+            // Not logged, logging every message would be measured instead of the server
+            if (is_echo_enabled_)
+            {
+                network_module_->send_to(session_id, std::string(data));
+                return;
+            }
+
+            if (is_binary)
+            {
+                LOG(INFO) << "Received " << data.size() << " bytes of binary data from " << session_id;
+                return;
+            }
+
+            LOG(INFO) << "Received from " << session_id << ": " << data;
         }
 
         bool Server::ServerImpl::send(const std::string &data)
@@ -163,7 +182,8 @@ namespace dummy
 
         bool Server::start(const int workers_number,
                            const std::string &config_path,
-                           const std::string &html_folder_path)
+                           const std::string &html_folder_path,
+                           const bool is_echo_enabled)
         {
             if (!server_impl_)
             {
@@ -174,7 +194,8 @@ namespace dummy
 
             return server_impl_->start(workers_number,
                                        config_path,
-                                       html_folder_path);
+                                       html_folder_path,
+                                       is_echo_enabled);
         }
 
         void Server::stop() noexcept
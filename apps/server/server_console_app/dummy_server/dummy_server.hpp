@@ -16,7 +16,8 @@ namespace dummy
 
             bool start(const int workers_number,
                        const std::string &config_path,
-                       const std::string &html_folder_path);
+                       const std::string &html_folder_path,
+                       const bool is_echo_enabled);
             void stop() noexcept;
 
             bool send(const std::string &data);
@@ -3,14 +3,22 @@
 #include "easylogging++.h"
 
 #include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string_view>
+
 namespace
 {
-    std::string load_file(const std::string &file_path)
+    const std::string kHomePage{"home/index.html"};
+    const std::string kKekPage{"kek/index.html"};
+    const std::string kPageNotFoundPage{"statuses/404/index.html"};
+
+    std::string load_file(const std::filesystem::path &file_path)
     {
-        std::fstream file_stream(file_path);
+        std::ifstream file_stream(file_path, std::ios::binary);
         if (!file_stream)
         {
-            LOG(ERROR) << "Can't load file: \"" << file_path << "\"";
+            LOG(ERROR) << "Can't load file: \"" << file_path.string() << "\"";
             return {};
         }
 
@@ -18,34 +26,187 @@ namespace
         string_stream << file_stream.rdbuf();
         return string_stream.str();
     }
+
+    std::string get_content_type(const std::filesystem::path &file_path)
+    {
+        static const std::map<std::string, std::string> kContentTypes{
+            {".html", "text/html; charset=utf-8"},
+            {".htm", "text/html; charset=utf-8"},
+            {".css", "text/css; charset=utf-8"},
+            {".js", "application/javascript"},
+            {".json", "application/json"},
+            {".txt", "text/plain; charset=utf-8"},
+            {".xml", "application/xml"},
+            {".svg", "image/svg+xml"},
+            {".png", "image/png"},
+            {".jpg", "image/jpeg"},
+            {".jpeg", "image/jpeg"},
+            {".gif", "image/gif"},
+            {".ico", "image/vnd.microsoft.icon"},
+            {".wasm", "application/wasm"}};
+
+        const auto kPosition = kContentTypes.find(file_path.extension().string());
+        if (kPosition == kContentTypes.end())
+            return "application/octet-stream";
+
+        return kPosition->second;
+    }
+
+    // Strong validator built from the size and the hash of the body
+    std::string make_etag(const std::string &body)
+    {
+        std::ostringstream string_stream;
+        string_stream << '"' << std::hex << body.size() << '-'
+                      << std::hash<std::string_view>{}(body) << '"';
+        return string_stream.str();
+    }
+
+    network_module::HttpContentPtr make_page(const std::filesystem::path &file_path)
+    {
+        auto page = std::make_shared<network_module::HttpContent>();
+        page->body_ = load_file(file_path);
+        page->content_type_ = get_content_type(file_path);
+        page->content_length_ = std::to_string(page->body_.size());
+        page->etag_ = make_etag(page->body_);
+        return page;
+    }
 }
 
 namespace dummy
 {
     namespace server
     {
-        PagesManager::PagesManager(const std::string &html_folder_path)
-            : kHtmlFolderPath_(html_folder_path) {}
+        PagesManager::PagesManager(const std::string &html_folder_path,
+                                   const std::chrono::milliseconds &refresh_period)
+            : kHtmlFolderPath_(html_folder_path),
+              kRefreshPeriod_(refresh_period)
+        {
+            snapshot_ = load_snapshot({});
+            LOG(INFO) << "Loaded " << snapshot_->pages_.size() << " page(s) from \"" << kHtmlFolderPath_.string() << "\"";
+
+            watcher_thread_ = std::thread(&PagesManager::run_watcher_thread, this);
+        }
 
-        std::string PagesManager::getHomePage()
+        PagesManager::~PagesManager()
         {
-            static const std::string kFilepath(kHtmlFolderPath_ + "home/index.html");
-            LOG(INFO) << "Loading file: \"" << kFilepath << "\"";
-            return load_file(kFilepath);
+            is_need_running_ = false;
+            watcher_condition_.notify_all();
+
+            if (watcher_thread_.joinable())
+                watcher_thread_.join();
         }
 
-        std::string PagesManager::getPageNotFoundPage()
+        network_module::HttpContentPtr PagesManager::getHomePage() const
         {
-            static const std::string kFilepath(kHtmlFolderPath_ + "statuses/404/index.html");
-            LOG(INFO) << "Loading file: \"" << kFilepath << "\"";
-            return load_file(kFilepath);
+            return getPage(kHomePage);
         }
 
-        std::string PagesManager::getKekPage()
+        network_module::HttpContentPtr PagesManager::getPageNotFoundPage() const
         {
-            static const std::string kFilepath(kHtmlFolderPath_ + "kek/index.html");
-            LOG(INFO) << "Loading file: \"" << kFilepath << "\"";
-            return load_file(kFilepath);
+            return getPage(kPageNotFoundPage);
+        }
+
+        network_module::HttpContentPtr PagesManager::getKekPage() const
+        {
+            return getPage(kKekPage);
+        }
+
+        network_module::HttpContentPtr PagesManager::getPage(const std::string &relative_path) const
+        {
+            const auto kSnapshot = get_snapshot();
+
+            const auto kPosition = kSnapshot->pages_.find(relative_path);
+            if (kPosition == kSnapshot->pages_.end())
+            {
+                LOG(ERROR) << "Page is not found: \"" << relative_path << "\"";
+                return {};
+            }
+
+            return kPosition->second;
+        }
+
+        bool PagesManager::refresh()
+        {
+            const auto kPrevious = get_snapshot();
+            auto snapshot = load_snapshot(kPrevious);
+
+            if (snapshot == kPrevious)
+                return false;
+
+            LOG(INFO) << "Pages are changed, reloaded " << snapshot->pages_.size() << " page(s)";
+
+            const std::lock_guard<std::mutex> lock(snapshot_mutex_);
+            snapshot_ = std::move(snapshot);
+            return true;
+        }
+
+        std::shared_ptr<const PagesManager::Snapshot> PagesManager::get_snapshot() const
+        {
+            const std::lock_guard<std::mutex> lock(snapshot_mutex_);
+            return snapshot_;
+        }
+
+        std::shared_ptr<const PagesManager::Snapshot> PagesManager::load_snapshot(const std::shared_ptr<const Snapshot> &previous) const
+        {
+            auto snapshot = std::make_shared<Snapshot>();
+
+            std::error_code error_code;
+            for (auto iter = std::filesystem::recursive_directory_iterator(kHtmlFolderPath_, error_code);
+                 !error_code && iter != std::filesystem::recursive_directory_iterator();
+                 iter.increment(error_code))
+            {
+                if (!iter->is_regular_file(error_code))
+                    continue;
+
+                const auto kRelativePath = iter->path().lexically_relative(kHtmlFolderPath_).generic_string();
+                const auto kStamp = std::make_pair(iter->last_write_time(error_code), iter->file_size(error_code));
+                if (error_code)
+                    break;
+
+                snapshot->stamps_.emplace(kRelativePath, kStamp);
+
+                // Unchanged files share the prepared page with the previous snapshot
+                if (previous)
+                {
+                    const auto kPreviousStamp = previous->stamps_.find(kRelativePath);
+                    if ((kPreviousStamp != previous->stamps_.end()) && (kPreviousStamp->second == kStamp))
+                    {
+                        snapshot->pages_.emplace(kRelativePath, previous->pages_.at(kRelativePath));
+                        continue;
+                    }
+                }
+
+                snapshot->pages_.emplace(kRelativePath, make_page(iter->path()));
+            }
+
+            if (error_code)
+            {
+                LOG(ERROR) << "Can't scan \"" << kHtmlFolderPath_.string() << "\" - " << error_code.message();
+                if (previous)
+                    return previous;
+            }
+
+            if (previous && (snapshot->stamps_ == previous->stamps_))
+                return previous;
+
+            return snapshot;
+        }
+
+        void PagesManager::run_watcher_thread()
+        {
+            while (is_need_running_)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(watcher_mutex_);
+                    watcher_condition_.wait_for(lock, kRefreshPeriod_, [this]
+                                                { return !is_need_running_; });
+                }
+
+                if (!is_need_running_)
+                    break;
+
+                refresh();
+            }
         }
     }
-}
\ No newline at end of file
+}
@@ -1,23 +1,66 @@
 #pragma once
 
 #include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <condition_variable>
+
+#include "network_module_common.hpp"
+
 namespace dummy
 {
     namespace server
     {
+        // Keeps the whole html folder in memory. Every page is prepared once
+        // (body, Content-Type, Content-Length, ETag) and served without disk access.
+        // A background thread watches the folder and swaps in a new snapshot
+        // when files change, requests in flight keep the pages they got.
         class PagesManager
         {
         public:
             PagesManager() = delete;
-            PagesManager(const std::string &html_folder_path);
-            ~PagesManager() = default;
+            PagesManager(const std::string &html_folder_path,
+                         const std::chrono::milliseconds &refresh_period = std::chrono::seconds(1));
+            ~PagesManager();
+
+            network_module::HttpContentPtr getPageNotFoundPage() const;
+            network_module::HttpContentPtr getHomePage() const;
+            network_module::HttpContentPtr getKekPage() const;
+
+            // Path is relative to the html folder, e.g. "home/index.html"
+            network_module::HttpContentPtr getPage(const std::string &relative_path) const;
+
+            bool refresh();
 
-            std::string getPageNotFoundPage();
-            std::string getHomePage();
-            std::string getKekPage();
+        private:
+            struct Snapshot
+            {
+                // Relative path -> last write time and size, used to detect changes
+                std::map<std::string, std::pair<std::filesystem::file_time_type, std::uintmax_t>> stamps_;
+                std::map<std::string, network_module::HttpContentPtr> pages_;
+            };
+
+            std::shared_ptr<const Snapshot> get_snapshot() const;
+            std::shared_ptr<const Snapshot> load_snapshot(const std::shared_ptr<const Snapshot> &previous) const;
+
+            void run_watcher_thread();
 
         private:
-            const std::string kHtmlFolderPath_;
+            const std::filesystem::path kHtmlFolderPath_;
+            const std::chrono::milliseconds kRefreshPeriod_;
+
+            mutable std::mutex snapshot_mutex_;
+            std::shared_ptr<const Snapshot> snapshot_;
+
+            std::atomic_bool is_need_running_{true};
+            std::mutex watcher_mutex_;
+            std::condition_variable watcher_condition_;
+            std::thread watcher_thread_;
         };
     }
 }
@@ -1,5 +1,6 @@
 #include <thread>
 #include <future>
+#include <string>
 
 #include "configs/cmake_config.h"
 
@@ -47,7 +48,7 @@ void wait_for_user_command(dummy::server::Server &server)
     }
 }
 
-int main()
+int main(int argc, char *argv[])
 {
     try
     {
@@ -63,13 +64,19 @@ int main()
         const auto kProcessorsCores = std::thread::hardware_concurrency();
         const auto kServerWorkersNumber = (kProcessorsCores > 1) ? (kProcessorsCores - 1) : 1;
 
+        // Websocket messages go back to their sender, for the load generator of the client
+        const bool kIsEchoEnabled = (argc > 1) && (std::string(argv[1]) == "--echo");
+        if (kIsEchoEnabled)
+            LOG(INFO) << "Echo mode";
+
         dummy::server::Server server(std::move(server_promise));
 
         try
         {
             if (!server.start(kServerWorkersNumber,
                               CMAKE_CURRENT_SOURCE_DIR + std::string{"/configs/server_config.json"},
-                              CMAKE_CURRENT_SOURCE_DIR + std::string{"/web_pages/"}))
+                              CMAKE_CURRENT_SOURCE_DIR + std::string{"/web_pages/"},
+                              kIsEchoEnabled))
             {
                 LOG(ERROR) << "Can't start server";
                 LOG(INFO) << "Shutting down the application";
@@ -0,0 +1,228 @@
+#include <map>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+
+#include "../network_module.hpp"
+#include "../server/router.hpp"
+
+#include "easylogging++.h"
+INITIALIZE_EASYLOGGINGPP
+
+namespace
+{
+    const std::size_t kIterationsNumber{2'000'000};
+
+    template <class Function>
+    void run_benchmark(const std::string &name,
+                       const std::vector<std::string> &targets,
+                       Function &&function)
+    {
+        std::size_t sink = 0;
+
+        const auto kBegin = std::chrono::steady_clock::now();
+        for (std::size_t iteration = 0; iteration < kIterationsNumber; ++iteration)
+            sink += function(targets[iteration % targets.size()]);
+        const auto kEnd = std::chrono::steady_clock::now();
+
+        const auto kNanoseconds = std::chrono::duration<double, std::nano>(kEnd - kBegin).count();
+
+        std::cout << std::left << std::setw(40) << name
+                  << std::fixed << std::setprecision(1) << (kNanoseconds / kIterationsNumber) << " ns/lookup"
+                  << " (" << sink << ")" << std::endl;
+    }
+}
+
+// Route lookup: std::map<Url, HttpCallback> as HttpSession used it
+// (std::string from the target, a second lookup of the not found page on a miss)
+// against the Router built from the same callbacks
+void benchmark_route_lookup()
+{
+    network_module::server::Server::Config::Callbacks callbacks;
+
+    std::vector<std::string> targets;
+
+    const auto kCallback = []()
+    { return std::string(); };
+
+    callbacks.http_callbacks_["/"] = kCallback;
+    callbacks.http_callbacks_[network_module::Urls::kPageNotFound_] = kCallback;
+    targets.push_back("/");
+
+    for (int section_i = 0; section_i < 8; ++section_i)
+    {
+        for (int page_i = 0; page_i < 8; ++page_i)
+        {
+            const std::string kUrl = "/section_" + std::to_string(section_i) + "/page_" + std::to_string(page_i);
+            callbacks.http_callbacks_[kUrl] = kCallback;
+            targets.push_back(kUrl);
+        }
+
+        targets.push_back("/section_" + std::to_string(section_i) + "/missing_page");
+    }
+
+    targets.push_back("/missing_section/page_0");
+
+    const Router kRouter(callbacks);
+
+    run_benchmark("std::map<Url, HttpCallback>", targets,
+                  [&](const std::string &target) -> std::size_t
+                  {
+                      const auto kPosition = callbacks.http_callbacks_.find(static_cast<network_module::Url>(target));
+                      if (kPosition != callbacks.http_callbacks_.end())
+                          return kPosition->first.size();
+
+                      return callbacks.http_callbacks_.at(network_module::Urls::kPageNotFound_) ? 1 : 0;
+                  });
+
+    network_module::HttpParameters parameters;
+
+    run_benchmark("Router", targets,
+                  [&](const std::string &target) -> std::size_t
+                  {
+                      const Router::Handler *handler = nullptr;
+                      if (kRouter.find(boost::beast::http::verb::get, target, parameters, handler) == Router::Status::kFound)
+                          return target.size();
+
+                      return kRouter.get_not_found_handler() ? 1 : 0;
+                  });
+}
+
+// Broadcast latency: time from the first Server::send of a burst of
+// burst_size messages till the last of sessions_number websocket clients
+// has all of them
+void benchmark_broadcast(const std::size_t &sessions_number,
+                         const std::size_t &message_size,
+                         const std::size_t &burst_size,
+                         const bool &is_write_coalescing)
+{
+    const std::size_t kRoundsNumber{20};
+    const std::string kMessage(message_size, 'x');
+
+    network_module::server::Server::Config config;
+    config.port_ = 18090;
+    config.web_socket_settings_.is_write_coalescing_ = is_write_coalescing;
+    config.callbacks_.web_sockets_callbacks_.process_new_connection_ = [](const network_module::web_sockets::SessionId &) {};
+    config.callbacks_.web_sockets_callbacks_.process_receiving_ = [](const network_module::web_sockets::SessionId &, const std::string_view &, const bool &) {};
+
+    network_module::server::Server server;
+    if (!server.start(static_cast<int>(std::max(1u, std::thread::hardware_concurrency())), config))
+        return;
+
+    typedef boost::beast::websocket::stream<boost::asio::ip::tcp::socket> Client;
+
+    boost::asio::io_context io_context;
+    std::vector<std::unique_ptr<Client>> clients;
+    std::vector<boost::beast::flat_buffer> buffers(sessions_number);
+    std::atomic<std::size_t> received_number{0};
+    std::atomic<std::size_t> frames_number{0};
+
+    const auto kSeparatorSize = config.web_socket_settings_.coalescing_separator_.size();
+
+    clients.reserve(sessions_number);
+
+    for (std::size_t client_i = 0; client_i < sessions_number; ++client_i)
+    {
+        clients.emplace_back(std::make_unique<Client>(io_context));
+
+        boost::system::error_code error_code;
+        clients.back()->next_layer().connect({boost::asio::ip::make_address(config.host_), static_cast<unsigned short>(config.port_)}, error_code);
+        if (!error_code)
+            clients.back()->handshake(config.host_, "/", error_code);
+
+        if (error_code)
+        {
+            std::cout << "Can't connect client " << client_i << " - " << error_code.message() << std::endl;
+            server.stop();
+            return;
+        }
+    }
+
+    // Sessions are registered after the handshake response is sent
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    std::function<void(std::size_t)> read = [&](std::size_t client_i)
+    {
+        clients[client_i]->async_read(buffers[client_i],
+                                      [&, client_i](boost::system::error_code error_code, std::size_t bytes_transferred)
+                                      {
+                                          if (error_code)
+                                              return;
+
+                                          // A coalesced frame holds messages joined by the separator
+                                          buffers[client_i].consume(buffers[client_i].size());
+                                          received_number += (bytes_transferred + kSeparatorSize) / (kMessage.size() + kSeparatorSize);
+                                          ++frames_number;
+                                          read(client_i);
+                                      });
+    };
+
+    for (std::size_t client_i = 0; client_i < sessions_number; ++client_i)
+        read(client_i);
+
+    std::thread reader([&]()
+                       { io_context.run(); });
+
+    double send_sum = 0;
+    double latency_sum = 0;
+    double latency_max = 0;
+
+    for (std::size_t round_i = 0; round_i < kRoundsNumber; ++round_i)
+    {
+        received_number = 0;
+
+        const auto kBegin = std::chrono::steady_clock::now();
+        for (std::size_t message_i = 0; message_i < burst_size; ++message_i)
+            server.send(kMessage);
+        const auto kSent = std::chrono::steady_clock::now();
+
+        while (received_number < sessions_number * burst_size)
+            std::this_thread::yield();
+
+        const auto kEnd = std::chrono::steady_clock::now();
+
+        const auto kLatency = std::chrono::duration<double, std::milli>(kEnd - kBegin).count();
+        send_sum += std::chrono::duration<double, std::milli>(kSent - kBegin).count();
+        latency_sum += kLatency;
+        latency_max = std::max(latency_max, kLatency);
+    }
+
+    std::cout << "Broadcast of " << burst_size << " x " << message_size << " bytes to " << sessions_number << " sessions"
+              << (is_write_coalescing ? " (coalescing): " : ": ")
+              << std::fixed << std::setprecision(2)
+              << "send() " << (send_sum / kRoundsNumber) << " ms, "
+              << "delivery " << (latency_sum / kRoundsNumber) << " ms (max " << latency_max << " ms), "
+              << (static_cast<double>(frames_number) / kRoundsNumber / sessions_number) << " frames per session" << std::endl;
+
+    server.stop();
+
+    io_context.stop();
+    reader.join();
+}
+
+// network_module_benchmarks [websocket sessions number] [broadcast message size] [burst size]
+int main(int argc, char *argv[])
+{
+    const std::size_t kSessionsNumber = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 5000;
+    const std::size_t kMessageSize = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 256;
+    const std::size_t kBurstSize = (argc > 3) ? std::strtoul(argv[3], nullptr, 10) : 1;
+
+    benchmark_route_lookup();
+    benchmark_broadcast(kSessionsNumber, kMessageSize, kBurstSize, false);
+    if (kBurstSize > 1)
+        benchmark_broadcast(kSessionsNumber, kMessageSize, kBurstSize, true);
+
+    return 0;
+}
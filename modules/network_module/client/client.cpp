@@ -1,30 +1,48 @@
 #include "../network_module.hpp"
 
 #include <memory>
-#include <chrono>
+#include <limits>
+#include <fstream>
+#include <algorithm>
 #include <vector>
 #include <thread>
-#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <optional>
 
 #include "boost/asio/io_context.hpp"
-#include "boost/asio/ip/tcp.hpp"
-#include "boost/beast.hpp"
-#include "boost/asio/strand.hpp"
-#include "boost/enable_shared_from_this.hpp"
-#include "boost/asio.hpp"
-#include "boost/bind.hpp"
-#include "boost/beast/websocket/stream_base.hpp"
+#include "boost/asio/executor_work_guard.hpp"
 
 #include "easylogging++.h"
 #define ELPP_THREAD_SAFE
 
 #include "json.hpp"
 
+#include "connection.hpp"
+#include "spool.hpp"
+
 namespace
 {
-    bool is_error_important(const boost::system::error_code &error_code)
+    const std::string kRoundRobinBalancing{"round_robin"};
+    const std::string kLeastQueuedBalancing{"least_queued"};
+    const std::string kKeyHashBalancing{"key_hash"};
+
+    network_module::client::Client::Config::Balancing parse_balancing(const std::string &balancing)
     {
-        return !(error_code == boost::asio::error::operation_aborted);
+        typedef network_module::client::Client::Config::Balancing Balancing;
+
+        if (balancing == kRoundRobinBalancing)
+            return Balancing::kRoundRobin;
+
+        if (balancing == kLeastQueuedBalancing)
+            return Balancing::kLeastQueued;
+
+        if (balancing == kKeyHashBalancing)
+            return Balancing::kKeyHash;
+
+        const std::string kErrorText{"Unknown balancing \"" + balancing + "\""};
+        LOG(ERROR) << kErrorText;
+        throw std::runtime_error(kErrorText);
     }
 }
 
@@ -37,8 +55,20 @@ namespace network_module
             nlohmann::json json_object;
             json_object["host"] = "127.0.0.1";
             json_object["port"] = 8080;
+            json_object["reconnect_initial_delay_ms"] = 100;
             json_object["reconnect_timeout_sec"] = 5;
             json_object["workers_number"] = 1;
+            json_object["connections_number"] = 1;
+            json_object["balancing"] = kRoundRobinBalancing;
+            json_object["send_queue_coalescing"] = false;
+            json_object["send_queue_coalescing_separator"] = "\n";
+            json_object["spool_path"] = "";
+            json_object["spool_max_size_mb"] = 64;
+            json_object["compression_enabled"] = false;
+            json_object["compression_max_window_bits"] = 15;
+            json_object["compression_memory_level"] = 4;
+            json_object["compression_level"] = 8;
+            json_object["compression_context_takeover"] = true;
 
             std::fstream file(config_path);
             if (!file.is_open())
@@ -70,8 +100,30 @@ namespace network_module
             network_module::client::Client::Config config;
             json_object.at("host").get_to(config.host_);
             json_object.at("port").get_to(config.port_);
+            config.reconnect_initial_delay_ms_ = json_object.value("reconnect_initial_delay_ms", config.reconnect_initial_delay_ms_);
             json_object.at("reconnect_timeout_sec").get_to(config.reconnect_timeout_sec_);
             json_object.at("workers_number").get_to(config.workers_number_);
+            config.connections_number_ = json_object.value("connections_number", config.connections_number_);
+            config.balancing_ = parse_balancing(json_object.value("balancing", kRoundRobinBalancing));
+            config.is_write_coalescing_ = json_object.value("send_queue_coalescing", config.is_write_coalescing_);
+            config.coalescing_separator_ = json_object.value("send_queue_coalescing_separator", config.coalescing_separator_);
+            config.spool_path_ = json_object.value("spool_path", config.spool_path_);
+            config.max_spool_size_mb_ = json_object.value("spool_max_size_mb", config.max_spool_size_mb_);
+
+            auto &compression = config.compression_;
+            compression.is_enabled_ = json_object.value("compression_enabled", compression.is_enabled_);
+            compression.max_window_bits_ = json_object.value("compression_max_window_bits", compression.max_window_bits_);
+            compression.memory_level_ = json_object.value("compression_memory_level", compression.memory_level_);
+            compression.level_ = json_object.value("compression_level", compression.level_);
+            compression.is_context_takeover_ = json_object.value("compression_context_takeover", compression.is_context_takeover_);
+
+            // Beast throws for such values only when a session applies them
+            const std::string kCompressionError{compression.get_error()};
+            if (!kCompressionError.empty())
+            {
+                LOG(ERROR) << kCompressionError;
+                throw std::runtime_error(kCompressionError);
+            }
 
             return config;
         }
@@ -82,7 +134,7 @@ namespace network_module
 {
     namespace client
     {
-        class Client::ClientImpl : public std::enable_shared_from_this<Client::ClientImpl>
+        class Client::ClientImpl
         {
         public:
             explicit ClientImpl();
@@ -93,48 +145,27 @@ namespace network_module
             bool is_running() const;
 
             bool send(const std::string &data);
+            bool send(const std::string &data, const std::string &key);
 
-        private:
-            void run_general_thread();
-
-            bool is_connection_activated() const;
-            bool activate_connection();
-            void deactivate_connection();
+            std::size_t get_connected_number() const;
 
         private:
-            void resolve();
-            void on_resolve(boost::beast::error_code error_code,
-                            boost::asio::ip::tcp::resolver::results_type results);
-            void on_connect(boost::beast::error_code error_code,
-                            boost::asio::ip::tcp::resolver::results_type::endpoint_type endpoint);
-            void on_handshake(boost::beast::error_code error_code);
-            void on_send(boost::beast::error_code error_code,
-                         std::size_t bytes_transferred);
-
-            void listen();
-            void on_receive(boost::beast::error_code error_code,
-                            std::size_t bytes_transferred);
-
-            void on_close(boost::beast::error_code error_code);
+            // Tries connections from the given one on, the first connected is used.
+            // While the spool has messages new ones go there too, to keep the order
+            bool send_from(const std::size_t &index, const std::string &data);
+            bool spool(const std::string &data);
+            std::size_t get_least_queued_index() const;
 
         private:
-            std::atomic_bool is_need_running_{false};
-            std::unique_ptr<std::thread> general_thread_;
-
-            std::unique_ptr<const Config> config_;
-
-            std::mutex connecting_mutex_;
-            std::condition_variable connecting_watcher_;
+            std::shared_ptr<const Config> config_;
+            std::shared_ptr<Spool> spool_;
 
             std::shared_ptr<boost::asio::io_context> io_context_;
+            std::optional<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> work_guard_;
+            std::vector<std::thread> workers_;
 
-            std::shared_ptr<boost::asio::ip::tcp::resolver> resolver_;
-            std::atomic_bool is_connected_{false};
-
-            std::mutex mutex_;
-            std::shared_ptr<boost::beast::websocket::stream<boost::beast::tcp_stream>> websocket_stream_;
-
-            boost::beast::flat_buffer buffer_;
+            std::vector<std::shared_ptr<Connection>> connections_;
+            std::atomic<std::size_t> next_connection_{0};
         };
 
         Client::ClientImpl::ClientImpl() {}
@@ -155,12 +186,48 @@ namespace network_module
                 return false;
             }
 
-            config_ = std::make_unique<const Config>(config);
+            const std::string kCompressionError{config.compression_.get_error()};
+            if (!kCompressionError.empty())
+            {
+                LOG(ERROR) << kCompressionError;
+                return false;
+            }
+
+            config_ = std::make_shared<const Config>(config);
+
+            if (!config_->spool_path_.empty())
+            {
+                spool_ = std::make_shared<Spool>(config_->spool_path_, std::max<std::size_t>(config_->max_spool_size_mb_, 1) * 1024 * 1024);
+                if (!spool_->open())
+                {
+                    LOG(ERROR) << "Can't open spool";
+                    spool_.reset();
+                    config_.reset();
+                    return false;
+                }
+            }
+
+            const int kWorkersNumber = std::max(config_->workers_number_, 1);
+            const int kConnectionsNumber = std::max(config_->connections_number_, 1);
+
+            io_context_ = std::make_shared<boost::asio::io_context>(kWorkersNumber);
+            work_guard_.emplace(boost::asio::make_work_guard(*io_context_));
 
-            is_need_running_ = true;
-            general_thread_ = std::make_unique<std::thread>(&Client::ClientImpl::run_general_thread, this);
+            connections_.reserve(kConnectionsNumber);
+            for (int index = 0; index < kConnectionsNumber; ++index)
+            {
+                connections_.push_back(std::make_shared<Connection>(*io_context_, config_, spool_, index));
+                connections_.back()->start();
+            }
 
-            LOG(DEBUG) << "Started";
+            workers_.reserve(kWorkersNumber);
+            for (int index = 0; index < kWorkersNumber; ++index)
+            {
+                workers_.emplace_back([io_context = io_context_]()
+                                      { io_context->run(); });
+            }
+
+            LOG(DEBUG) << "Started with " << kConnectionsNumber << " connections on " << kWorkersNumber << " workers";
             return true;
         }
 
@@ -174,23 +241,19 @@ namespace network_module
                 return;
             }
 
-            if (io_context_)
-            {
-                io_context_->stop();
-            }
-            else
-            {
-                LOG(ERROR) << "io_context is null";
-            }
-
-            is_need_running_ = false;
+            // Connections close gracefully, workers leave when nothing is pending
+            for (auto &connection : connections_)
+                connection->stop();
 
-            connecting_watcher_.notify_all();
-            general_thread_->join();
-            general_thread_.reset();
+            work_guard_.reset();
 
-            deactivate_connection();
+            for (auto &worker : workers_)
+                worker.join();
+            workers_.clear();
 
+            connections_.clear();
+            io_context_.reset();
+            spool_.reset();
             config_.reset();
 
             LOG(DEBUG) << "Stopped";
@@ -198,119 +261,30 @@ namespace network_module
 
         bool Client::ClientImpl::is_running() const
         {
-            if (!general_thread_)
-                return false;
-
-            if (!general_thread_->joinable())
-                return false;
-
-            return true;
+            return !workers_.empty();
         }
 
-        bool Client::ClientImpl::is_connection_activated() const
-        {
-            if (!io_context_)
-                return false;
-
-            if (!resolver_)
-                return false;
-
-            if (!websocket_stream_)
-                return false;
-
-            return true;
-        }
-
-        bool Client::ClientImpl::activate_connection()
+        bool Client::ClientImpl::send(const std::string &data)
         {
-            LOG(DEBUG) << "Activating connection...";
-
-            if (is_connection_activated())
-            {
-                LOG(DEBUG) << "Connection already activated";
-                return false;
-            }
-
-            io_context_.reset(new boost::asio::io_context(/* number of threads */));
-            if (!io_context_)
+            if (!is_running())
             {
-                LOG(ERROR) << "Can't create io_context";
+                LOG(ERROR) << "Client is not running";
                 return false;
             }
 
-            resolver_.reset(new boost::asio::ip::tcp::resolver(*io_context_));
-            if (!resolver_)
+            switch (config_->balancing_)
             {
-                LOG(ERROR) << "Can't create resolver";
-                return false;
-            }
+            case Config::Balancing::kLeastQueued:
+                return send_from(get_least_queued_index(), data);
 
-            websocket_stream_.reset(new boost::beast::websocket::stream<boost::beast::tcp_stream>(*io_context_));
-            if (!websocket_stream_)
-            {
-                LOG(ERROR) << "Can't create websocket_stream";
-                return false;
+            case Config::Balancing::kRoundRobin:
+            case Config::Balancing::kKeyHash: // Messages without a key are spread evenly
+            default:
+                return send_from(next_connection_++ % connections_.size(), data);
             }
-
-            resolve();
-            io_context_->run();
-
-            return true;
         }
 
-        void Client::ClientImpl::deactivate_connection()
-        {
-            LOG(DEBUG) << "Deactivating connection...";
-
-            if (!is_connection_activated())
-            {
-                LOG(DEBUG) << "Connection already deactivated";
-                return;
-            }
-
-            if (websocket_stream_->is_open())
-            {
-                LOG(DEBUG) << "Signaling to socket about closing";
-                websocket_stream_->async_close(boost::beast::websocket::close_code::normal,
-                                               boost::bind(&Client::ClientImpl::on_close,
-                                                           this,
-                                                           boost::asio::placeholders::error));
-            }
-
-            websocket_stream_.reset();
-            resolver_.reset();
-            io_context_.reset();
-
-            is_connected_ = false;
-
-            LOG(DEBUG) << "Connection deactivated";
-        }
-
-        void Client::ClientImpl::run_general_thread()
-        {
-            LOG(DEBUG) << "Begin of general thread";
-
-            while (is_need_running_)
-            {
-                if (!activate_connection())
-                {
-                    LOG(ERROR) << "Can't activate connection";
-                    deactivate_connection();
-                    break;
-                }
-
-                {
-                    std::unique_lock<std::mutex> lock(connecting_mutex_);
-                    connecting_watcher_.wait_for(lock, std::chrono::seconds(config_->reconnect_timeout_sec_));
-                }
-
-                deactivate_connection();
-            }
-
-            LOG(DEBUG) << "End of general thread";
-        }
-
-        bool Client::ClientImpl::send(const std::string &data)
+        bool Client::ClientImpl::send(const std::string &data, const std::string &key)
         {
             if (!is_running())
             {
@@ -318,151 +292,85 @@ namespace network_module
                 return false;
             }
 
-            websocket_stream_->async_write(
-                boost::asio::buffer(data),
-                boost::bind(&Client::ClientImpl::on_send,
-                            this,
-                            boost::asio::placeholders::error,
-                            boost::asio::placeholders::bytes_transferred));
+            if (config_->balancing_ != Config::Balancing::kKeyHash)
+                return send(data);
 
-            return true;
+            return send_from(std::hash<std::string>{}(key) % connections_.size(), data);
         }
 
-        void Client::ClientImpl::resolve()
+        std::size_t Client::ClientImpl::get_connected_number() const
         {
-            LOG(DEBUG) << "Waiting for connection ( " << config_->host_ << " : " << config_->port_ << " ) ...";
-
-            resolver_->async_resolve(
-                config_->host_.c_str(), std::to_string(config_->port_),
-                boost::bind(&Client::ClientImpl::on_resolve,
-                            this,
-                            boost::asio::placeholders::error,
-                            boost::asio::placeholders::results));
-        }
-
-        void Client::ClientImpl::on_resolve(boost::beast::error_code error_code,
-                                            boost::asio::ip::tcp::resolver::results_type results)
-        {
-            LOG(DEBUG);
-
-            if (error_code)
+            std::size_t connected_number{0};
+            for (const auto &kConnection : connections_)
             {
-                LOG(ERROR) << "Error " << error_code << " " << error_code.message();
-                connecting_watcher_.notify_all();
-                return;
+                if (kConnection->is_connected())
+                    ++connected_number;
             }
 
-            // Set the timeout for the operation
-            // boost::beast::get_lowest_layer(*websocket_stream_).expires_after(std::chrono::seconds(5));
-            // Make the connection on the IP address we get from a lookup
-            boost::beast::get_lowest_layer(*websocket_stream_).async_connect(results, boost::bind(&Client::ClientImpl::on_connect, this, boost::asio::placeholders::error, boost::asio::placeholders::endpoint));
+            return connected_number;
         }
 
-        void Client::ClientImpl::on_connect(boost::beast::error_code error_code,
-                                            boost::asio::ip::tcp::resolver::results_type::endpoint_type endpoint)
+        bool Client::ClientImpl::send_from(const std::size_t &index, const std::string &data)
         {
-            LOG(DEBUG);
+            if (spool_ && !spool_->is_empty())
+                return spool(data);
+
+            // One copy of the message, owned by the queue of the connection until written
+            auto message = std::make_shared<const std::string>(data);
 
-            if (error_code)
+            for (std::size_t offset = 0; offset < connections_.size(); ++offset)
             {
-                LOG(ERROR) << "Error " << error_code << " " << error_code.message();
-                connecting_watcher_.notify_all();
-                return;
+                if (connections_[(index + offset) % connections_.size()]->send(message))
+                    return true;
             }
 
-            // Turn off the timeout on the tcp_stream, because
-            // the websocket stream has its own timeout system.
-            boost::beast::get_lowest_layer(*websocket_stream_).expires_never();
+            if (spool_)
+                return spool(data);
 
-            // Set suggested timeout settings for the websocket
-            websocket_stream_->set_option(boost::beast::websocket::stream_base::timeout::suggested(
-                boost::beast::role_type::client));
-
-            // Set a decorator to change the User-Agent of the handshake
-            websocket_stream_->set_option(boost::beast::websocket::stream_base::decorator(
-                [](boost::beast::websocket::request_type &req)
-                {
-                    req.set(boost::beast::http::field::user_agent,
-                            std::string(BOOST_BEAST_VERSION_STRING) +
-                                " websocket-client-async");
-                }));
-
-            const std::string kHostAndPort = config_->host_ + std::string(":") + std::to_string(config_->port_);
-
-            websocket_stream_->async_handshake(
-                kHostAndPort.c_str(),
-                "/",
-                boost::bind(&Client::ClientImpl::on_handshake,
-                            this,
-                            boost::asio::placeholders::error));
+            LOG(WARNING) << "No connection to send";
+            return false;
         }
 
-        void Client::ClientImpl::on_handshake(boost::beast::error_code error_code)
+        bool Client::ClientImpl::spool(const std::string &data)
         {
-            if (error_code)
+            if (!spool_->append(data))
             {
-                LOG(ERROR) << "Error " << error_code << " " << error_code.message();
-                connecting_watcher_.notify_all();
-                return;
+                LOG(WARNING) << "Spool is full";
+                return false;
             }
 
-            LOG(DEBUG) << "Connection established";
-
-            is_connected_ = true;
-            connecting_watcher_.notify_all();
-
-            listen();
-            config_->callbacks_.on_start_();
-        }
-
-        void Client::ClientImpl::on_send(boost::beast::error_code error_code,
-                                         std::size_t bytes_transferred)
-        {
-            if (error_code)
+            // A connection established meanwhile has finished its replaying already
+            for (const auto &kConnection : connections_)
             {
-                LOG(ERROR) << "Error " << error_code << " " << error_code.message();
-                connecting_watcher_.notify_all();
-                return;
+                if (kConnection->is_connected())
+                {
+                    kConnection->replay_spool();
+                    break;
+                }
             }
 
-            LOG(DEBUG) << "Sent " << bytes_transferred << " bytes";
+            return true;
         }
 
-        void Client::ClientImpl::listen()
+        std::size_t Client::ClientImpl::get_least_queued_index() const
         {
-            websocket_stream_->async_read(
-                buffer_,
-                boost::bind(
-                    &Client::ClientImpl::on_receive,
-                    this,
-                    boost::asio::placeholders::error,
-                    boost::asio::placeholders::bytes_transferred));
-        }
+            std::size_t least_index{0};
+            std::size_t least_queued{std::numeric_limits<std::size_t>::max()};
 
-        void Client::ClientImpl::on_receive(boost::beast::error_code error_code,
-                                            std::size_t bytes_transferred)
-        {
-            if (error_code)
+            for (std::size_t index = 0; index < connections_.size(); ++index)
             {
-                LOG(ERROR) << "Error " << error_code << " " << error_code.message();
-                connecting_watcher_.notify_all();
-                return;
-            }
+                if (!connections_[index]->is_connected())
+                    continue;
 
-            config_->callbacks_.process_receiving_(boost::beast::buffers_to_string(buffer_.data()));
-            buffer_.clear();
-            listen();
-        }
-
-        void Client::ClientImpl::on_close(boost::beast::error_code error_code)
-        {
-            if (error_code)
-            {
-                LOG(ERROR) << "Error " << error_code << " " << error_code.message();
-                return;
+                const std::size_t kQueued = connections_[index]->get_queued_number();
+                if (kQueued < least_queued)
+                {
+                    least_index = index;
+                    least_queued = kQueued;
+                }
             }
 
-            LOG(DEBUG) << "Closed";
+            return least_index;
         }
     }
 }
@@ -520,5 +428,28 @@ namespace network_module
 
             return client_impl_->send(data);
         }
+
+        bool Client::send(const std::string &data, const std::string &key)
+        {
+            if (!client_impl_)
+            {
+                static const std::string kErrorText("Implementation is not created");
+                LOG(ERROR) << kErrorText;
+                throw std::runtime_error(kErrorText);
+            }
+
+            return client_impl_->send(data, key);
+        }
+
+        std::size_t Client::get_connected_number() const
+        {
+            if (!client_impl_)
+            {
+                LOG(ERROR) << "Implementation is not created";
+                return 0;
+            }
+
+            return client_impl_->get_connected_number();
+        }
     }
 }
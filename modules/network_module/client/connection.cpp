@@ -0,0 +1,612 @@
+#include "connection.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <charconv>
+#include <iterator>
+#include <algorithm>
+
+#include <boost/asio/post.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/beast/core/buffers_to_string.hpp>
+#include <boost/beast/websocket/stream_base.hpp>
+
+#include "easylogging++.h"
+
+namespace
+{
+    bool is_error_important(const boost::system::error_code &error_code)
+    {
+        return !((error_code == boost::asio::error::operation_aborted) ||
+                 (error_code == boost::beast::websocket::error::closed));
+    }
+
+    // Time given to the closing handshake when the client stops
+    const std::chrono::seconds kCloseTimeout{1};
+
+    // Spooled bytes queued at a time while replaying
+    const std::size_t kReplayBatchBytes{1024 * 1024};
+}
+
+Connection::Connection(boost::asio::io_context &io_context,
+                       std::shared_ptr<const network_module::client::Client::Config> config,
+                       std::shared_ptr<Spool> spool,
+                       const std::size_t &index)
+    : kConfig_(std::move(config)),
+      kIndex_(index),
+      strand_(boost::asio::make_strand(io_context)),
+      resolver_(strand_),
+      reconnect_timer_(strand_),
+      random_engine_(std::random_device{}()),
+      websocket_(strand_),
+      spool_(std::move(spool))
+{
+    // Pongs come on the strand while reading
+    websocket_.control_callback([this](boost::beast::websocket::frame_type kind, boost::beast::string_view payload)
+                                {
+                                    if (kind == boost::beast::websocket::frame_type::pong)
+                                        on_pong(payload); });
+}
+
+void Connection::start()
+{
+    boost::asio::post(strand_,
+                      [self = shared_from_this()]()
+                      {
+                          self->connect();
+                      });
+}
+
+void Connection::stop()
+{
+    boost::asio::post(strand_,
+                      [self = shared_from_this()]()
+                      {
+                          self->is_stopped_ = true;
+                          self->is_connected_ = false;
+
+                          self->reconnect_timer_.cancel();
+                          self->resolver_.cancel();
+
+                          if (!self->websocket_.is_open())
+                          {
+                              boost::beast::error_code error_code;
+                              boost::beast::get_lowest_layer(self->websocket_).socket().close(error_code);
+                              return;
+                          }
+
+                          boost::beast::websocket::stream_base::timeout timeout{};
+                          timeout.handshake_timeout = kCloseTimeout;
+                          timeout.idle_timeout = boost::beast::websocket::stream_base::none();
+                          timeout.keep_alive_pings = false;
+                          self->websocket_.set_option(timeout);
+
+                          // The pending read fails after closing and the connection is left
+                          self->websocket_.async_close(boost::beast::websocket::close_code::normal,
+                                                        [self](boost::beast::error_code error_code)
+                                                        {
+                                                            if (error_code && is_error_important(error_code))
+                                                                LOG(DEBUG) << "Connection " << self->kIndex_ << " closing - " << error_code.message();
+                                                        });
+                      });
+}
+
+bool Connection::send(MessagePtr message)
+{
+    if (!is_connected_)
+        return false;
+
+    ++queued_number_;
+    outgoing_.push(std::move(message));
+
+    if (!is_flush_scheduled_.exchange(true))
+    {
+        boost::asio::post(strand_,
+                          [self = shared_from_this()]()
+                          {
+                              self->flush();
+                          });
+    }
+
+    return true;
+}
+
+void Connection::replay_spool()
+{
+    boost::asio::post(strand_,
+                      [self = shared_from_this()]()
+                      {
+                          self->start_replay();
+                      });
+}
+
+bool Connection::is_connected() const
+{
+    return is_connected_;
+}
+
+std::size_t Connection::get_queued_number() const
+{
+    return queued_number_;
+}
+
+void Connection::connect()
+{
+    if (is_stopped_)
+        return;
+
+    LOG(DEBUG) << "Connection " << kIndex_ << " is connecting ( " << kConfig_->host_ << " : " << kConfig_->port_ << " ) ...";
+
+    buffer_.clear();
+
+    resolver_.async_resolve(kConfig_->host_, std::to_string(kConfig_->port_),
+                            [self = shared_from_this()](boost::beast::error_code error_code,
+                                                        boost::asio::ip::tcp::resolver::results_type results)
+                            {
+                                self->on_resolve(error_code, std::move(results));
+                            });
+}
+
+void Connection::on_resolve(boost::beast::error_code error_code,
+                            boost::asio::ip::tcp::resolver::results_type results)
+{
+    if (error_code)
+    {
+        if (is_error_important(error_code))
+            LOG(ERROR) << "Connection " << kIndex_ << " can't resolve - " << error_code.message();
+
+        reconnect();
+        return;
+    }
+
+    boost::beast::get_lowest_layer(websocket_).async_connect(
+        results,
+        [self = shared_from_this()](boost::beast::error_code error_code,
+                                    boost::asio::ip::tcp::resolver::results_type::endpoint_type endpoint)
+        {
+            self->on_connect(error_code, endpoint);
+        });
+}
+
+void Connection::on_connect(boost::beast::error_code error_code,
+                            boost::asio::ip::tcp::resolver::results_type::endpoint_type)
+{
+    if (error_code)
+    {
+        if (is_error_important(error_code))
+            LOG(ERROR) << "Connection " << kIndex_ << " can't connect - " << error_code.message();
+
+        reconnect();
+        return;
+    }
+
+    // Turn off the timeout on the tcp_stream, because
+    // the websocket stream has its own timeout system.
+    boost::beast::get_lowest_layer(websocket_).expires_never();
+
+    // Set suggested timeout settings for the websocket
+    websocket_.set_option(boost::beast::websocket::stream_base::timeout::suggested(
+        boost::beast::role_type::client));
+
+    const auto &kCompression = kConfig_->compression_;
+    if (kCompression.is_enabled_)
+    {
+        boost::beast::websocket::permessage_deflate option;
+        option.client_enable = true;
+        option.server_max_window_bits = kCompression.max_window_bits_;
+        option.client_max_window_bits = kCompression.max_window_bits_;
+        option.server_no_context_takeover = !kCompression.is_context_takeover_;
+        option.client_no_context_takeover = !kCompression.is_context_takeover_;
+        option.memLevel = kCompression.memory_level_;
+        option.compLevel = kCompression.level_;
+        websocket_.set_option(option);
+    }
+
+    // Set a decorator to change the User-Agent of the handshake
+    websocket_.set_option(boost::beast::websocket::stream_base::decorator(
+        [](boost::beast::websocket::request_type &req)
+        {
+            req.set(boost::beast::http::field::user_agent,
+                    std::string(BOOST_BEAST_VERSION_STRING) +
+                        " websocket-client-async");
+        }));
+
+    const std::string kHostAndPort = kConfig_->host_ + std::string(":") + std::to_string(kConfig_->port_);
+
+    websocket_.async_handshake(kHostAndPort, "/",
+                                [self = shared_from_this()](boost::beast::error_code error_code)
+                                {
+                                    self->on_handshake(error_code);
+                                });
+}
+
+void Connection::on_handshake(boost::beast::error_code error_code)
+{
+    if (error_code)
+    {
+        if (is_error_important(error_code))
+            LOG(ERROR) << "Connection " << kIndex_ << " handshake - " << error_code.message();
+
+        reconnect();
+        return;
+    }
+
+    if (is_stopped_)
+        return;
+
+    LOG(DEBUG) << "Connection " << kIndex_ << " established";
+
+    reconnect_attempts_ = 0;
+    is_connected_ = true;
+
+    read();
+
+    // Messages kept while disconnected go before new ones
+    start_replay();
+
+    if (kConfig_->callbacks_.on_start_)
+        kConfig_->callbacks_.on_start_();
+}
+
+void Connection::read()
+{
+    websocket_.async_read(buffer_,
+                           [self = shared_from_this()](boost::beast::error_code error_code, std::size_t bytes_transferred)
+                           {
+                               self->on_read(error_code, bytes_transferred);
+                           });
+}
+
+void Connection::on_read(boost::beast::error_code error_code, std::size_t)
+{
+    if (error_code)
+    {
+        if (is_error_important(error_code))
+            LOG(ERROR) << "Connection " << kIndex_ << " is lost - " << error_code.message();
+
+        // The server answered our closing handshake after reading everything written before
+        if (is_stopped_ && (error_code == boost::beast::websocket::error::closed))
+            confirm(written_number_);
+
+        reconnect();
+        return;
+    }
+
+    // Flat buffer holds the message contiguously, the callback gets a view of it
+    kConfig_->callbacks_.process_receiving_(std::string_view(static_cast<const char *>(buffer_.data().data()), buffer_.size()),
+                                            websocket_.got_binary());
+    buffer_.clear();
+
+    read();
+}
+
+void Connection::flush()
+{
+    // Cleared before taking, a message pushed after it schedules the next flush
+    is_flush_scheduled_ = false;
+
+    // Connection was lost after the messages were given to it
+    if (!is_connected_)
+    {
+        std::vector<MessagePtr> messages;
+        queued_number_ -= outgoing_.take_all(messages);
+        respool(messages);
+        return;
+    }
+
+    enqueued_number_ += outgoing_.take_all(queue_);
+
+    if (!queue_.empty() && writing_messages_.empty())
+        write();
+}
+
+void Connection::write()
+{
+    const auto &kConfig = *kConfig_;
+
+    writing_generation_ = generation_;
+    std::move(queue_.begin(), queue_.end(), std::back_inserter(writing_messages_));
+    queue_.clear();
+
+    if (!kConfig.is_write_coalescing_)
+    {
+        writing_message_i_ = 0;
+        writing_bytes_ = 0;
+        write_frame();
+        return;
+    }
+
+    writing_buffers_.clear();
+
+    for (const auto &kMessage : writing_messages_)
+    {
+        if (!writing_buffers_.empty() && !kConfig.coalescing_separator_.empty())
+            writing_buffers_.push_back(boost::asio::buffer(kConfig.coalescing_separator_));
+
+        writing_buffers_.push_back(boost::asio::buffer(*kMessage));
+    }
+
+    websocket_.async_write(writing_buffers_,
+                           [self = shared_from_this()](boost::beast::error_code error_code, std::size_t bytes_transferred)
+                           {
+                               self->on_write(error_code, bytes_transferred);
+                           });
+}
+
+void Connection::write_frame()
+{
+    websocket_.async_write(boost::asio::buffer(*writing_messages_[writing_message_i_]),
+                           [self = shared_from_this()](boost::beast::error_code error_code, std::size_t bytes_transferred)
+                           {
+                               self->on_write_frame(error_code, bytes_transferred);
+                           });
+}
+
+void Connection::on_write_frame(boost::beast::error_code error_code, std::size_t bytes_transferred)
+{
+    writing_bytes_ += bytes_transferred;
+
+    // A failed frame fails the whole batch, the server may get its first messages twice
+    if (!error_code && (++writing_message_i_ < writing_messages_.size()))
+    {
+        write_frame();
+        return;
+    }
+
+    on_write(error_code, writing_bytes_);
+}
+
+void Connection::on_write(boost::beast::error_code error_code, std::size_t bytes_transferred)
+{
+    const std::size_t kWrittenNumber = writing_messages_.size();
+
+    // Messages of the current connection go back to the queue, the failed read
+    // reconnects and puts them into the spool
+    if (error_code && (writing_generation_ == generation_))
+    {
+        if (is_error_important(error_code))
+            LOG(ERROR) << "Connection " << kIndex_ << " can't send - " << error_code.message();
+
+        queue_.insert(queue_.begin(), std::make_move_iterator(writing_messages_.begin()), std::make_move_iterator(writing_messages_.end()));
+        writing_messages_.clear();
+        return;
+    }
+
+    queued_number_ -= kWrittenNumber;
+
+    if (!error_code && (writing_generation_ == generation_))
+    {
+        written_number_ += kWrittenNumber;
+
+        if (spool_)
+        {
+            std::move(writing_messages_.begin(), writing_messages_.end(), std::back_inserter(unconfirmed_));
+            ping();
+        }
+
+        // The next batch is queued without waiting for the confirmation of this one
+        if (is_replaying_ && is_replay_written())
+            replay_next();
+    }
+
+    writing_messages_.clear();
+
+    // The failed read reconnects
+    if (error_code)
+    {
+        if (is_error_important(error_code))
+            LOG(ERROR) << "Connection " << kIndex_ << " can't send - " << error_code.message();
+    }
+    else
+    {
+        LOG(DEBUG) << "Sent " << bytes_transferred << " bytes";
+    }
+
+    // A write of the previous connection can complete after reconnecting
+    if (!queue_.empty() && is_connected_)
+        write();
+}
+
+void Connection::ping()
+{
+    if (is_ping_pending_ || !is_connected_ || (pinged_number_ == written_number_))
+        return;
+
+    is_ping_pending_ = true;
+    pinged_number_ = written_number_;
+
+    // One ping at a time, the next one covers everything written meanwhile
+    websocket_.async_ping(boost::beast::websocket::ping_data(std::to_string(pinged_number_)),
+                          [self = shared_from_this()](boost::beast::error_code)
+                          {
+                              self->is_ping_pending_ = false;
+                              self->ping();
+                          });
+}
+
+void Connection::on_pong(const boost::beast::string_view &payload)
+{
+    std::uint64_t messages_number = 0;
+    if (std::from_chars(payload.data(), payload.data() + payload.size(), messages_number).ec != std::errc())
+        return;
+
+    confirm(messages_number);
+}
+
+void Connection::confirm(const std::uint64_t &messages_number)
+{
+    // Pongs of a lost connection don't come, numbers of the current one only grow
+    if ((messages_number <= confirmed_number_) || (messages_number > written_number_))
+        return;
+
+    const std::size_t kConfirmedNumber = std::min<std::size_t>(messages_number - confirmed_number_, unconfirmed_.size());
+    unconfirmed_.erase(unconfirmed_.begin(), unconfirmed_.begin() + kConfirmedNumber);
+    confirmed_number_ = messages_number;
+
+    if (!spool_)
+        return;
+
+    while (!replay_batches_.empty() && (replay_batches_.front().end_ <= confirmed_number_))
+    {
+        spool_->commit(replay_batches_.front().bytes_);
+        replay_batches_.pop_front();
+    }
+
+    // Replaying waits for confirmations when the spool has nothing more to read
+    if (is_replaying_ && is_replay_written())
+        replay_next();
+}
+
+void Connection::start_replay()
+{
+    if (!spool_ || !is_connected_ || is_replaying_)
+        return;
+
+    if (!spool_->begin_replay())
+        return;
+
+    LOG(DEBUG) << "Connection " << kIndex_ << " replays the spool";
+
+    is_replaying_ = true;
+    replay_next();
+}
+
+void Connection::replay_next()
+{
+    std::vector<MessagePtr> messages;
+    const std::size_t kBytes = spool_->read(messages, kReplayBatchBytes);
+
+    if (messages.empty())
+    {
+        // The spool ends the replaying when everything read from it is committed
+        if (replay_batches_.empty())
+        {
+            LOG(DEBUG) << "Connection " << kIndex_ << " replayed the spool";
+            is_replaying_ = false;
+        }
+
+        return;
+    }
+
+    replay_batches_.push_back({enqueued_number_, enqueued_number_ + messages.size(), kBytes});
+
+    queued_number_ += messages.size();
+    enqueued_number_ += messages.size();
+
+    for (auto &message : messages)
+        queue_.push_back(std::move(message));
+
+    if (writing_messages_.empty())
+        write();
+}
+
+bool Connection::is_replay_written() const
+{
+    return replay_batches_.empty() || (written_number_ >= replay_batches_.back().end_);
+}
+
+void Connection::respool()
+{
+    // Messages after the confirmed ones in the order of queueing, then the ones
+    // sent and not taken yet. The pending write of a previous connection
+    // was put back by its reconnecting
+    std::vector<MessagePtr> messages;
+    std::uint64_t message_i = confirmed_number_;
+    auto batch = replay_batches_.begin();
+
+    const auto kAdd = [&](const MessagePtr &message)
+    {
+        while ((batch != replay_batches_.end()) && (batch->end_ <= message_i))
+            ++batch;
+
+        if ((batch == replay_batches_.end()) || (message_i < batch->begin_))
+            messages.push_back(message);
+
+        ++message_i;
+    };
+
+    for (const auto &kMessage : unconfirmed_)
+        kAdd(kMessage);
+
+    if (writing_generation_ == generation_)
+    {
+        for (const auto &kMessage : writing_messages_)
+            kAdd(kMessage);
+    }
+
+    for (const auto &kMessage : queue_)
+        kAdd(kMessage);
+
+    std::vector<MessagePtr> outgoing;
+    queued_number_ -= outgoing_.take_all(outgoing);
+    std::move(outgoing.begin(), outgoing.end(), std::back_inserter(messages));
+
+    respool(messages);
+}
+
+void Connection::respool(const std::vector<MessagePtr> &messages)
+{
+    if (!spool_ || messages.empty())
+        return;
+
+    const std::size_t kRestoredNumber = spool_->restore(messages);
+    if (kRestoredNumber < messages.size())
+        LOG(WARNING) << "Spool is full, connection " << kIndex_ << " lost " << (messages.size() - kRestoredNumber) << " message(s)";
+}
+
+void Connection::reconnect()
+{
+    is_connected_ = false;
+
+    // Before ending the replaying, the restored messages go after the ones it read
+    respool();
+
+    // The pending write, if any, releases its messages when it fails
+    queued_number_ -= queue_.size();
+    queue_.clear();
+    unconfirmed_.clear();
+    replay_batches_.clear();
+
+    // Messages of the spool not committed yet are replayed by the next connection
+    if (is_replaying_)
+    {
+        is_replaying_ = false;
+        spool_->end_replay();
+    }
+
+    ++generation_;
+    enqueued_number_ = 0;
+    written_number_ = 0;
+    confirmed_number_ = 0;
+    pinged_number_ = 0;
+
+    // The next async_connect opens the socket again, the websocket is reset by the handshake
+    boost::beast::error_code error_code;
+    boost::beast::get_lowest_layer(websocket_).socket().close(error_code);
+
+    if (is_stopped_)
+        return;
+
+    const auto kDelay = get_reconnect_delay();
+    LOG(DEBUG) << "Connection " << kIndex_ << " reconnects in " << kDelay.count() << " ms";
+
+    reconnect_timer_.expires_after(kDelay);
+    reconnect_timer_.async_wait([self = shared_from_this()](boost::beast::error_code error_code)
+                                {
+                                    if (!error_code)
+                                        self->connect(); });
+}
+
+std::chrono::milliseconds Connection::get_reconnect_delay()
+{
+    const std::int64_t kInitialDelay = std::max(kConfig_->reconnect_initial_delay_ms_, 1);
+    const std::int64_t kMaxDelay = std::max<std::int64_t>(std::int64_t(kConfig_->reconnect_timeout_sec_) * 1000, kInitialDelay);
+
+    // Shifting is bounded, the delay reaches the cap long before an overflow
+    const std::size_t kShift = std::min<std::size_t>(reconnect_attempts_, 30);
+    const std::int64_t kDelay = std::min(kInitialDelay << kShift, kMaxDelay);
+    ++reconnect_attempts_;
+
+    std::uniform_int_distribution<std::int64_t> jitter(0, kDelay - kDelay / 2);
+    return std::chrono::milliseconds(kDelay / 2 + jitter(random_engine_));
+}
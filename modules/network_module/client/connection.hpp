@@ -0,0 +1,151 @@
+#pragma once
+
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <boost/asio/strand.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/beast/core/tcp_stream.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/websocket/stream.hpp>
+
+#include "../network_module.hpp"
+#include "mpsc_queue.hpp"
+#include "spool.hpp"
+
+// One websocket connection of the client. All its operations run on its own
+// strand, so any number of io threads can run the connections of a client.
+// A lost connection is established again by itself, independently of others,
+// after an exponential backoff with jitter, the same stream is reused.
+// With a spool, written messages are kept until the pong of a ping sent after
+// them proves the server has read them, a lost connection puts every message
+// it was given and the server didn't confirm back to the spool
+class Connection : public std::enable_shared_from_this<Connection>
+{
+public:
+    typedef std::shared_ptr<const std::string> MessagePtr;
+
+    Connection() = delete;
+    Connection(boost::asio::io_context &io_context,
+               std::shared_ptr<const network_module::client::Client::Config> config,
+               std::shared_ptr<Spool> spool,
+               const std::size_t &index);
+    ~Connection() = default;
+
+    void start();
+    // Closes the connection and stops reconnecting, can be called from any thread
+    void stop();
+
+    // Can be called from any thread without locking, false when the connection
+    // isn't established. Messages of one thread keep their order
+    bool send(MessagePtr message);
+
+    // Writes messages of the spool if no other connection does it,
+    // can be called from any thread
+    void replay_spool();
+
+    bool is_connected() const;
+    // Messages waiting to be written
+    std::size_t get_queued_number() const;
+
+private:
+    void connect();
+    void on_resolve(boost::beast::error_code error_code,
+                    boost::asio::ip::tcp::resolver::results_type results);
+    void on_connect(boost::beast::error_code error_code,
+                    boost::asio::ip::tcp::resolver::results_type::endpoint_type endpoint);
+    void on_handshake(boost::beast::error_code error_code);
+
+    void read();
+    void on_read(boost::beast::error_code error_code, std::size_t bytes_transferred);
+
+    // The payload of a ping is the number of messages written before it
+    void ping();
+    void on_pong(const boost::beast::string_view &payload);
+    // Releases the first messages_number written messages, commits replayed ones
+    void confirm(const std::uint64_t &messages_number);
+
+    // Moves everything sent so far from the lock-free queue to queue_
+    void flush();
+    // Writes the whole queue as one batch, in one frame with coalescing
+    void write();
+    // Frames of a batch are written back to back, the batch completes after the last one
+    void write_frame();
+    void on_write_frame(boost::beast::error_code error_code, std::size_t bytes_transferred);
+    void on_write(boost::beast::error_code error_code, std::size_t bytes_transferred);
+
+    void start_replay();
+    // Queues the next messages of the spool, the replaying ends when it is empty
+    // and everything read from it is confirmed
+    void replay_next();
+    bool is_replay_written() const;
+
+    // Not confirmed messages of the spool stay in it, others are put back in their order
+    void respool();
+    void respool(const std::vector<MessagePtr> &messages);
+
+    // Drops the socket and queued messages, connects again after get_reconnect_delay
+    void reconnect();
+    // Doubles with every failed attempt up to reconnect_timeout_sec_. A random
+    // value between half of it and all of it is returned, so clients lost
+    // together don't come back together
+    std::chrono::milliseconds get_reconnect_delay();
+
+private:
+    const std::shared_ptr<const network_module::client::Client::Config> kConfig_;
+    const std::size_t kIndex_;
+
+    boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+    boost::asio::ip::tcp::resolver resolver_;
+    boost::asio::steady_timer reconnect_timer_;
+    std::size_t reconnect_attempts_{0}; // Since the last established connection
+    std::minstd_rand random_engine_;
+
+    boost::beast::websocket::stream<boost::beast::tcp_stream> websocket_;
+    boost::beast::flat_buffer buffer_;
+
+    MpscQueue<MessagePtr> outgoing_;
+    std::atomic<bool> is_flush_scheduled_{false}; // One post for a batch of sends
+
+    std::deque<MessagePtr> queue_;
+    std::vector<MessagePtr> writing_messages_; // Kept alive until the write completes
+    std::vector<boost::asio::const_buffer> writing_buffers_;
+    std::size_t writing_message_i_{0};
+    std::size_t writing_bytes_{0};
+    std::atomic<std::size_t> queued_number_{0};
+
+    // Messages are numbered in the order of queueing by the connection, the
+    // numbers start again with every reconnecting
+    std::shared_ptr<Spool> spool_;
+    std::uint64_t enqueued_number_{0};
+    std::uint64_t written_number_{0};
+    std::uint64_t generation_{0}; // Changes with every reconnecting
+    std::uint64_t writing_generation_{0};
+
+    // Written and not confirmed yet, the first is message confirmed_number_
+    std::deque<MessagePtr> unconfirmed_;
+    std::uint64_t confirmed_number_{0};
+    std::uint64_t pinged_number_{0};
+    bool is_ping_pending_{false};
+
+    // Messages of the spool queued as a batch, committed when all are confirmed
+    struct ReplayBatch
+    {
+        std::uint64_t begin_{0};
+        std::uint64_t end_{0};
+        std::size_t bytes_{0};
+    };
+    std::deque<ReplayBatch> replay_batches_;
+    bool is_replaying_{false};
+
+    std::atomic<bool> is_connected_{false};
+    std::atomic<bool> is_stopped_{false};
+};
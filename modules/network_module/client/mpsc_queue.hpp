@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// Lock-free queue of many producers and one consumer. Producers push to an
+// intrusive stack with one compare-exchange, the consumer takes everything
+// pushed so far with one exchange and gets it back in the order of pushing.
+// Taking all at once batches the work of the consumer for free
+template <class T>
+class MpscQueue
+{
+public:
+    MpscQueue() = default;
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    ~MpscQueue()
+    {
+        delete_nodes(head_.exchange(nullptr));
+    }
+
+    // Can be called from any thread
+    void push(T value)
+    {
+        Node *const kNode = new Node{std::move(value), head_.load(std::memory_order_relaxed)};
+
+        while (!head_.compare_exchange_weak(kNode->next_, kNode,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed))
+        {
+        }
+    }
+
+    // Only one thread at a time, values are appended in the order of pushing,
+    // returns their number
+    template <class Container>
+    std::size_t take_all(Container &container)
+    {
+        Node *node = head_.exchange(nullptr, std::memory_order_acquire);
+
+        // The stack is newest first
+        Node *reversed = nullptr;
+        while (node)
+        {
+            Node *const kNext = node->next_;
+            node->next_ = reversed;
+            reversed = node;
+            node = kNext;
+        }
+
+        std::size_t values_number = 0;
+        while (reversed)
+        {
+            container.push_back(std::move(reversed->value_));
+            ++values_number;
+
+            Node *const kNext = reversed->next_;
+            delete reversed;
+            reversed = kNext;
+        }
+
+        return values_number;
+    }
+
+private:
+    struct Node
+    {
+        T value_;
+        Node *next_;
+    };
+
+    static void delete_nodes(Node *node)
+    {
+        while (node)
+        {
+            Node *const kNext = node->next_;
+            delete node;
+            node = kNext;
+        }
+    }
+
+private:
+    std::atomic<Node *> head_{nullptr};
+};
@@ -0,0 +1,238 @@
+#include "spool.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+
+#include <boost/interprocess/exceptions.hpp>
+
+#include "easylogging++.h"
+
+namespace
+{
+    const std::uint64_t kMagic{0x314c4f4f50534e4dULL}; // "MNSPOOL1"
+}
+
+Spool::Spool(const std::string &path, const std::size_t &max_size)
+    : kPath_(path),
+      kCapacity_(max_size)
+{
+}
+
+bool Spool::open()
+{
+    LOG(DEBUG) << "Opening spool \"" << kPath_ << "\"...";
+
+    const std::uint64_t kFileSize = sizeof(Header) + kCapacity_;
+
+    try
+    {
+        std::error_code error_code;
+        if (!std::filesystem::exists(kPath_, error_code))
+        {
+            std::ofstream file(kPath_, std::ios::binary);
+            if (!file.is_open())
+            {
+                LOG(ERROR) << "Can't create spool \"" << kPath_ << "\"";
+                return false;
+            }
+        }
+
+        // Messages left beyond a smaller capacity would be cut, the old file is kept
+        // as long as it fits
+        std::filesystem::resize_file(kPath_, std::max<std::uint64_t>(kFileSize, std::filesystem::file_size(kPath_)));
+
+        file_ = boost::interprocess::file_mapping(kPath_.c_str(), boost::interprocess::read_write);
+        region_ = boost::interprocess::mapped_region(file_, boost::interprocess::read_write, 0, kFileSize);
+    }
+    catch (const std::exception &exception)
+    {
+        LOG(ERROR) << "Can't map spool \"" << kPath_ << "\" - " << exception.what();
+        return false;
+    }
+
+    header_ = static_cast<Header *>(region_.get_address());
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if ((header_->magic_ != kMagic) ||
+        (header_->begin_ > header_->end_) ||
+        (header_->end_ > kCapacity_))
+    {
+        if (header_->magic_ == kMagic)
+            LOG(WARNING) << "Spool \"" << kPath_ << "\" doesn't fit its capacity, messages in it are dropped";
+
+        header_->magic_ = kMagic;
+        reset();
+    }
+
+    is_empty_ = (header_->begin_ == header_->end_);
+
+    LOG(DEBUG) << "Spool opened with " << (header_->end_ - header_->begin_) << " bytes";
+    return true;
+}
+
+bool Spool::append(const std::string &message)
+{
+    const std::uint64_t kRecordSize = sizeof(RecordSize) + message.size();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (header_->end_ + kRecordSize > kCapacity_)
+        compact();
+
+    if (header_->end_ + kRecordSize > kCapacity_)
+        return false;
+
+    const RecordSize kMessageSize = static_cast<RecordSize>(message.size());
+    std::memcpy(get_data() + header_->end_, &kMessageSize, sizeof(kMessageSize));
+    std::memcpy(get_data() + header_->end_ + sizeof(kMessageSize), message.data(), message.size());
+
+    // Offsets are stored after the message, a crash in between loses only it
+    header_->end_ += kRecordSize;
+    is_empty_ = false;
+
+    return true;
+}
+
+bool Spool::is_empty() const
+{
+    return is_empty_;
+}
+
+bool Spool::begin_replay()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (is_replaying_ || (header_->begin_ == header_->end_))
+        return false;
+
+    is_replaying_ = true;
+    cursor_ = header_->begin_;
+
+    return true;
+}
+
+std::size_t Spool::read(std::vector<MessagePtr> &messages, const std::size_t &max_bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    const std::uint64_t kStart = cursor_;
+
+    while ((cursor_ < header_->end_) && (messages.empty() || (cursor_ - kStart < max_bytes)))
+    {
+        RecordSize message_size = 0;
+        std::memcpy(&message_size, get_data() + cursor_, sizeof(message_size));
+
+        if (cursor_ + sizeof(message_size) + message_size > header_->end_)
+        {
+            LOG(ERROR) << "Spool \"" << kPath_ << "\" is corrupted, messages in it are dropped";
+            reset();
+            messages.clear();
+            is_replaying_ = false;
+            return 0;
+        }
+
+        const char *const kMessage = reinterpret_cast<const char *>(get_data() + cursor_ + sizeof(message_size));
+        messages.push_back(std::make_shared<const std::string>(kMessage, message_size));
+
+        cursor_ += sizeof(message_size) + message_size;
+    }
+
+    // Messages read before wait for their confirmation, the replaying goes on
+    if (messages.empty() && (cursor_ == header_->begin_))
+        is_replaying_ = false;
+
+    return cursor_ - kStart;
+}
+
+void Spool::commit(const std::size_t &bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    header_->begin_ = std::min<std::uint64_t>(header_->begin_ + bytes, header_->end_);
+
+    if (header_->begin_ == header_->end_)
+        reset();
+}
+
+void Spool::end_replay()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    is_replaying_ = false;
+}
+
+std::size_t Spool::restore(const std::vector<MessagePtr> &messages)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::uint64_t records_size = 0;
+    for (const auto &kMessage : messages)
+        records_size += sizeof(RecordSize) + kMessage->size();
+
+    if (header_->end_ + records_size > kCapacity_)
+        compact();
+
+    // A replaying goes on with them, messages it read wait for their commit
+    std::uint64_t position = is_replaying_ ? cursor_ : header_->begin_;
+    const std::uint64_t kTailSize = header_->end_ - position;
+
+    std::size_t restored_number = 0;
+    records_size = 0;
+    for (const auto &kMessage : messages)
+    {
+        const std::uint64_t kRecordSize = sizeof(RecordSize) + kMessage->size();
+        if (header_->end_ + records_size + kRecordSize > kCapacity_)
+            break;
+
+        records_size += kRecordSize;
+        ++restored_number;
+    }
+
+    if (restored_number == 0)
+        return 0;
+
+    std::memmove(get_data() + position + records_size, get_data() + position, kTailSize);
+
+    for (std::size_t message_i = 0; message_i < restored_number; ++message_i)
+    {
+        const auto &kMessage = *messages[message_i];
+        const RecordSize kMessageSize = static_cast<RecordSize>(kMessage.size());
+
+        std::memcpy(get_data() + position, &kMessageSize, sizeof(kMessageSize));
+        std::memcpy(get_data() + position + sizeof(kMessageSize), kMessage.data(), kMessage.size());
+        position += sizeof(kMessageSize) + kMessage.size();
+    }
+
+    header_->end_ += records_size;
+    is_empty_ = false;
+
+    return restored_number;
+}
+
+void Spool::compact()
+{
+    const std::uint64_t kShift = header_->begin_;
+    if (kShift == 0)
+        return;
+
+    std::memmove(get_data(), get_data() + kShift, header_->end_ - kShift);
+
+    header_->end_ -= kShift;
+    header_->begin_ = 0;
+    cursor_ -= std::min(cursor_, kShift);
+}
+
+void Spool::reset()
+{
+    header_->begin_ = 0;
+    header_->end_ = 0;
+    cursor_ = 0;
+    is_empty_ = true;
+}
+
+std::uint8_t *Spool::get_data() const
+{
+    return reinterpret_cast<std::uint8_t *>(header_) + sizeof(Header);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+// Messages sent while the client has no connection, appended to a memory
+// mapped file of a fixed size. The file outlives the client, messages left
+// in it are replayed by the next one. They are removed only after the server
+// confirmed them, so a message can be sent twice but isn't lost
+class Spool
+{
+public:
+    typedef std::shared_ptr<const std::string> MessagePtr;
+
+    Spool() = delete;
+    Spool(const std::string &path, const std::size_t &max_size);
+    ~Spool() = default;
+
+    // Creates or maps the file, false when it can't be used
+    bool open();
+
+    // Can be called from any thread, false when the spool is full
+    bool append(const std::string &message);
+    bool is_empty() const;
+
+    // One replaying at a time, false when the spool is empty or replayed already
+    bool begin_replay();
+    // Messages after the previous read up to max_bytes (at least one),
+    // returns the bytes to commit after they are confirmed. Nothing read when
+    // everything read is committed ends the replaying, so a message appended
+    // meanwhile starts the next one
+    std::size_t read(std::vector<MessagePtr> &messages, const std::size_t &max_bytes);
+    // Removes the oldest bytes of the messages read
+    void commit(const std::size_t &bytes);
+    // Uncommitted messages are read again by the next replaying
+    void end_replay();
+
+    // Puts back messages a lost connection had taken, before the messages not
+    // read yet. Can be called from any thread, returns the number of restored
+    // ones, the newest don't fit into a full spool
+    std::size_t restore(const std::vector<MessagePtr> &messages);
+
+private:
+    struct Header
+    {
+        std::uint64_t magic_;
+        std::uint64_t begin_; // Offsets in the data after the header
+        std::uint64_t end_;
+    };
+
+    typedef std::uint32_t RecordSize;
+
+    // Moves the messages to the beginning of the data
+    void compact();
+    void reset();
+
+    std::uint8_t *get_data() const;
+
+private:
+    const std::string kPath_;
+    const std::size_t kCapacity_; // Without the header
+
+    mutable std::mutex mutex_;
+    boost::interprocess::file_mapping file_;
+    boost::interprocess::mapped_region region_;
+    Header *header_{nullptr};
+
+    bool is_replaying_{false};
+    std::uint64_t cursor_{0}; // Where the next read starts
+    std::atomic<bool> is_empty_{true};
+};
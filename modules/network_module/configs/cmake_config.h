@@ -0,0 +1 @@
+#define CMAKE_CURRENT_SOURCE_DIR "/root/repo/modules/network_module"
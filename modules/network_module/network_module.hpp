@@ -5,6 +5,8 @@
 #include <utility>
 #include <functional>
 #include <map>
+#include <vector>
+#include <cstdint>
 
 #include "network_module_common.hpp"
 
@@ -22,21 +24,95 @@ namespace network_module
                 std::string host_{"127.0.0.1"};
                 int port_{8080};
 
+                enum class IoMode
+                {
+                    kShared, // All workers run one io_context with one acceptor
+                    kSharded // Every worker runs its own io_context with its own SO_REUSEPORT acceptor
+                };
+                IoMode io_mode_{IoMode::kShared};
+
+                struct HttpSettings
+                {
+                    int request_timeout_sec_{60};      // Time to receive the first request of a connection
+                    int keep_alive_timeout_sec_{5};    // Idle time allowed between requests of a persistent connection
+                    int write_timeout_sec_{60};        // Time to write a response, for storage files the time without progress
+                    int max_keep_alive_requests_{100}; // Requests served by one connection before it is closed
+                    int blocking_threads_number_{0};   // Threads running blocking route handlers, 0 runs them on io threads
+
+                    std::string storage_root_path_;               // Files under it are served by GET, empty disables storage
+                    std::string storage_url_prefix_{"/storage/"}; // Url of the storage root
+                    int max_upload_size_mb_{4096};                // Limit of a file put to the storage by PUT or POST
+                } http_settings_;
+
+                struct WebSocketSettings
+                {
+                    // What a session does with a new message when its send queue is full
+                    enum class OverflowPolicy
+                    {
+                        kDropOldest, // Oldest queued message is dropped
+                        kDropNewest, // New message is dropped
+                        kCoalesce,   // New message replaces the queued one of the same key, otherwise the oldest is dropped
+                        kDisconnect  // Slow client is disconnected
+                    };
+
+                    std::size_t max_queue_messages_{1024};          // Messages waiting to be sent to one session
+                    std::size_t max_queue_bytes_{16 * 1024 * 1024}; // Bytes waiting to be sent to one session
+                    OverflowPolicy overflow_policy_{OverflowPolicy::kDropOldest};
+
+                    // Messages queued while a write is in progress go out together as
+                    // one frame, joined by the separator, in one gather write.
+                    // Receivers have to split frames by the separator themselves.
+                    // Otherwise every message is its own frame and write: a beast 1.74
+                    // stream writes one message per operation, and it answers pings and
+                    // closes from inside reads, so frames built by hand and written to
+                    // the socket in one gather write could be interleaved with them
+                    bool is_write_coalescing_{false};
+                    std::string coalescing_separator_{"\n"};
+
+                    // Messages {"subscribe": "<topic>"} and {"unsubscribe": "<topic>"} of
+                    // clients manage their topics and aren't passed to process_receiving_
+                    bool is_topics_enabled_{false};
+                    std::size_t max_topics_per_session_{64};
+
+                    // Received messages are given to process_receiving_ on a pool of this number of
+                    // threads, in order within a session, 0 calls it on io threads. A session stops
+                    // reading while max_receiving_queue_messages_ of its messages wait for the pool
+                    int receiving_threads_number_{0};
+                    std::size_t max_receiving_queue_messages_{64};
+
+                    web_sockets::CompressionSettings compression_;
+
+                    // A session quiet for an interval is pinged and is closed when nothing comes
+                    // during the next one, so dead peers are evicted. 0 disables pings
+                    int ping_interval_sec_{30};
+                } web_socket_settings_;
+
                 struct Callbacks
                 {
                     SignalToStop signal_to_stop_;
 
                     struct WebSocketsCallbacks
                     {
-                        web_sockets::OnStartCallback process_new_connection_;
-                        web_sockets::ReceivingCallback process_receiving_;
+                        web_sockets::OnSessionStartCallback process_new_connection_;
+                        web_sockets::SessionReceivingCallback process_receiving_;
                     } web_sockets_callbacks_;
 
                     std::map<Url, HttpCallback> http_callbacks_;
+                    std::map<Url, HttpContentCallback> http_content_callbacks_;
+                    std::vector<HttpRoute> http_routes_;
 
                 } callbacks_;
             };
 
+            struct Statistics
+            {
+                std::size_t sessions_number_{0};
+                std::size_t queued_messages_{0}; // In send queues of all sessions
+                std::size_t queued_bytes_{0};
+                std::uint64_t dropped_messages_{0};      // By overflow policies
+                std::uint64_t disconnected_sessions_{0}; // By OverflowPolicy::kDisconnect
+            };
+
         public:
             Server();
             ~Server();
@@ -45,6 +121,19 @@ namespace network_module
             void stop();
 
             bool send(const std::string &data);
+            // Queued messages of the same non-empty key are coalesced by OverflowPolicy::kCoalesce
+            bool send(const std::string &data, const std::string &key);
+
+            // Returns false when the session is closed already
+            bool send_to(const web_sockets::SessionId &session_id, const std::string &data);
+            // One message shared by the sessions, returns the number of them still open
+            std::size_t send_to(const std::vector<web_sockets::SessionId> &sessions_ids, const std::string &data);
+
+            // Goes only to the sessions subscribed to the topic,
+            // returns false when there are no subscribers
+            bool publish(const std::string &topic, const std::string &data);
+
+            Statistics get_statistics() const;
 
         private:
             class ServerImpl;
@@ -64,8 +153,38 @@ namespace network_module
                 std::string host_{"127.0.0.1"};
                 int port_{8080};
 
+                // Reconnecting waits for an exponentially growing delay with jitter,
+                // starting from the initial one and capped by reconnect_timeout_sec_
+                int reconnect_initial_delay_ms_{100};
                 int reconnect_timeout_sec_{5};
-                int workers_number_{1};
+                int workers_number_{1}; // I/O threads shared by all connections
+
+                // Every connection reconnects independently, on_start_ is called
+                // for each of them and callbacks can come from any I/O thread
+                int connections_number_{1};
+
+                // How send picks a connection, skipping ones that aren't connected
+                enum class Balancing
+                {
+                    kRoundRobin,
+                    kLeastQueued, // The fewest messages waiting to be written
+                    kKeyHash      // Same key, same connection, keeps the order per key
+                } balancing_{Balancing::kRoundRobin};
+
+                // Messages sent while a write is in progress are written as one batch,
+                // each in its own frame, one after another. With coalescing they go
+                // out as one frame joined by the separator, the server has to split them
+                bool is_write_coalescing_{false};
+                std::string coalescing_separator_{"\n"};
+
+                // Messages sent while no connection is established are appended to
+                // this memory-mapped file, empty to drop them. They are replayed in
+                // order by the next established connection, at least once, also
+                // after a restart of the application
+                std::string spool_path_;
+                std::size_t max_spool_size_mb_{64};
+
+                web_sockets::CompressionSettings compression_;
 
                 struct Callbacks
                 {
@@ -85,6 +204,10 @@ namespace network_module
             bool is_running() const;
 
             bool send(const std::string &data);
+            // Messages with the same key go through the same connection while it is connected
+            bool send(const std::string &data, const std::string &key);
+
+            std::size_t get_connected_number() const;
 
         private:
             class ClientImpl;
@@ -1,6 +1,52 @@
 #include "network_module_common.hpp"
 
+#include <algorithm>
+#include <cctype>
+
 namespace network_module
 {
     const Url Urls::kPageNotFound_ = "/404";
-}
\ No newline at end of file
+
+    std::string_view HttpRequest::get_parameter(const std::string_view &name) const
+    {
+        for (const auto &kParameter : parameters_)
+        {
+            if (kParameter.first == name)
+                return kParameter.second;
+        }
+
+        return {};
+    }
+
+    std::string_view HttpRequest::get_header(const std::string_view &name) const
+    {
+        for (const auto &kHeader : headers_)
+        {
+            if ((kHeader.first.size() == name.size()) &&
+                std::equal(name.begin(), name.end(), kHeader.first.begin(),
+                           [](const char &left, const char &right)
+                           { return std::tolower(static_cast<unsigned char>(left)) ==
+                                    std::tolower(static_cast<unsigned char>(right)); }))
+                return kHeader.second;
+        }
+
+        return {};
+    }
+
+    namespace web_sockets
+    {
+        std::string CompressionSettings::get_error() const
+        {
+            if ((max_window_bits_ < 9) || (max_window_bits_ > 15))
+                return "Compression max window bits " + std::to_string(max_window_bits_) + " are out of 9..15";
+
+            if ((memory_level_ < 1) || (memory_level_ > 9))
+                return "Compression memory level " + std::to_string(memory_level_) + " is out of 1..9";
+
+            if ((level_ < 0) || (level_ > 9))
+                return "Compression level " + std::to_string(level_) + " is out of 0..9";
+
+            return {};
+        }
+    }
+}
@@ -1,6 +1,11 @@
 #pragma once
 
 #include <string>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <memory>
 #include <functional>
 
 namespace network_module
@@ -8,14 +13,101 @@ namespace network_module
     typedef std::string Url;
     typedef std::function<std::string()> HttpCallback;
 
+    // Prepared HTTP resource. Instances are immutable and shared by all
+    // requests, so the body is written to the socket without copying
+    struct HttpContent
+    {
+        std::string body_;
+        std::string content_type_;
+        std::string content_length_;
+        std::string etag_; // Strong validator in quotes, e.g. "1a2b-3c4d"
+    };
+    typedef std::shared_ptr<const HttpContent> HttpContentPtr;
+    typedef std::function<HttpContentPtr()> HttpContentCallback;
+
+    typedef std::vector<std::pair<std::string_view, std::string_view>> HttpParameters;
+    typedef std::vector<std::pair<std::string_view, std::string_view>> HttpHeaders;
+
+    // Request as seen by route handlers. Views are valid during the call of
+    // a synchronous handler and until an asynchronous one responds
+    struct HttpRequest
+    {
+        std::string_view method_;
+        std::string_view target_;
+        std::string_view path_;
+        std::string_view query_;
+
+        // Values of ":name" segments of the route pattern and of its trailing "*"
+        HttpParameters parameters_;
+
+        // Filled for asynchronous and blocking handlers only
+        HttpHeaders headers_;
+        std::string_view body_;
+
+        std::string_view get_parameter(const std::string_view &name) const;
+        std::string_view get_header(const std::string_view &name) const; // Name is case insensitive
+    };
+    typedef std::function<std::string(const HttpRequest &)> HttpRequestCallback;
+
+    struct HttpResponse
+    {
+        unsigned status_{200};
+        std::string content_type_{"text/html"};
+        std::vector<std::pair<std::string, std::string>> headers_;
+        std::string body_;
+    };
+    // Has to be called once, from any thread. Keeps the connection alive until it is called
+    typedef std::function<void(HttpResponse)> HttpResponder;
+    typedef std::function<void(const HttpRequest &, HttpResponder)> HttpAsyncCallback;
+
+    // Pattern segments are static ("users"), parameters (":id") or a trailing
+    // wildcard ("*") which takes the rest of the path. Either callback_ or
+    // async_callback_ is set. Blocking handlers run on the blocking pool of
+    // the server (HttpSettings::blocking_threads_number_) instead of io threads
+    struct HttpRoute
+    {
+        std::string method_{"GET"};
+        Url pattern_;
+        HttpRequestCallback callback_;
+        HttpAsyncCallback async_callback_;
+        bool is_blocking_{false};
+    };
+
     typedef std::function<void()> SignalToStop;
 
     namespace web_sockets
     {
-        typedef std::function<void(const std::string &)> ReceivingCallback;
+        typedef std::uint64_t SessionId;
+
+        // Data is a view of the receive buffer, valid only during the call
+        typedef std::function<void(const std::string_view &data, const bool &is_binary)> ReceivingCallback;
         typedef std::function<std::string()> SendingCallback;
 
         typedef std::function<void()> OnStartCallback;
+
+        // permessage-deflate, used when both sides enable it. Settings apply to both
+        // directions, a deflate stream costs memory per connection and direction.
+        // Every message of a stream is deflated on its own, beast 1.74 has no
+        // per-message switch, so neither a size threshold nor one compression
+        // shared by the recipients of a broadcast is possible
+        struct CompressionSettings
+        {
+            // Empty when the values are in the ranges zlib accepts
+            std::string get_error() const;
+
+            bool is_enabled_{false};
+            int max_window_bits_{15}; // 9..15, window of 2^bits bytes
+            int memory_level_{4};     // 1..9
+            int level_{8};            // 0..9
+            // false resets the window after every message, less memory
+            // per connection for a worse ratio of small similar messages
+            bool is_context_takeover_{true};
+        };
+
+        // Server callbacks get the session the event came from, the id
+        // can be used to answer it with Server::send_to
+        typedef std::function<void(const SessionId &)> OnSessionStartCallback;
+        typedef std::function<void(const SessionId &, const std::string_view &data, const bool &is_binary)> SessionReceivingCallback;
     }
 
     struct Urls
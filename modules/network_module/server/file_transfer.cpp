@@ -0,0 +1,232 @@
+#include "file_transfer.hpp"
+
+#include <algorithm>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/write.hpp>
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <cerrno>
+#endif
+
+namespace
+{
+    // Bytes sent in one go before giving other handlers of the thread a turn
+    const std::uint64_t kMaxChunkSize{1024 * 1024};
+}
+
+FileTransfer::FileTransfer(boost::asio::ip::tcp::socket &socket,
+                           boost::beast::file file,
+                           std::vector<Part> parts)
+    : socket_(socket),
+      file_(std::move(file)),
+      kParts_(std::move(parts))
+{
+}
+
+void FileTransfer::start(CompletionHandler handler,
+                         ProgressHandler progress_handler)
+{
+    handler_ = std::move(handler);
+    progress_handler_ = std::move(progress_handler);
+
+    if (kParts_.empty())
+    {
+        finish({});
+        return;
+    }
+
+#ifdef __linux__
+    boost::system::error_code error_code;
+    socket_.native_non_blocking(true, error_code);
+    if (error_code)
+    {
+        finish(error_code);
+        return;
+    }
+#endif
+
+    write_head();
+}
+
+void FileTransfer::write_head()
+{
+    const auto &kPart = kParts_.at(part_i_);
+
+    part_offset_ = kPart.offset_;
+    part_left_ = kPart.size_;
+
+    if (kPart.head_.empty())
+    {
+        write_file();
+        return;
+    }
+
+    boost::asio::async_write(
+        socket_,
+        boost::asio::buffer(kPart.head_),
+        [self = shared_from_this()](boost::system::error_code error_code, std::size_t bytes_transferred)
+        {
+            self->on_write_head(error_code, bytes_transferred);
+        });
+}
+
+void FileTransfer::on_write_head(boost::system::error_code error_code, std::size_t bytes_transferred)
+{
+    if (error_code)
+    {
+        finish(error_code);
+        return;
+    }
+
+    bytes_transferred_ += bytes_transferred;
+    on_progress();
+
+    write_file();
+}
+
+#ifdef __linux__
+
+void FileTransfer::write_file()
+{
+    while (part_left_ > 0)
+    {
+        off_t offset = static_cast<off_t>(part_offset_);
+
+        const auto kResult = ::sendfile(socket_.native_handle(),
+                                        file_.native_handle(),
+                                        &offset,
+                                        static_cast<std::size_t>(std::min(part_left_, kMaxChunkSize)));
+        if (kResult < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+            {
+                finish({errno, boost::system::system_category()});
+                return;
+            }
+        }
+        else if (kResult == 0)
+        {
+            // File became shorter than announced in Content-Length
+            finish(boost::asio::error::eof);
+            return;
+        }
+        else
+        {
+            part_offset_ += kResult;
+            part_left_ -= kResult;
+            bytes_transferred_ += kResult;
+            on_progress();
+
+            if (part_left_ == 0)
+                break;
+        }
+
+        // Socket buffer is full or the chunk is sent, continue when the socket is writable
+        socket_.async_wait(
+            boost::asio::ip::tcp::socket::wait_write,
+            [self = shared_from_this()](boost::system::error_code error_code)
+            {
+                self->on_write_file(error_code, 0);
+            });
+        return;
+    }
+
+    next_part();
+}
+
+#else
+
+void FileTransfer::write_file()
+{
+    if (part_left_ == 0)
+    {
+        next_part();
+        return;
+    }
+
+    boost::system::error_code error_code;
+
+    file_.seek(part_offset_, error_code);
+    if (error_code)
+    {
+        finish(error_code);
+        return;
+    }
+
+    const auto kSize = file_.read(buffer_.data(),
+                                  static_cast<std::size_t>(std::min<std::uint64_t>(part_left_, buffer_.size())),
+                                  error_code);
+    if (error_code)
+    {
+        finish(error_code);
+        return;
+    }
+
+    if (kSize == 0)
+    {
+        finish(boost::asio::error::eof);
+        return;
+    }
+
+    part_offset_ += kSize;
+    part_left_ -= kSize;
+
+    boost::asio::async_write(
+        socket_,
+        boost::asio::buffer(buffer_.data(), kSize),
+        [self = shared_from_this()](boost::system::error_code error_code, std::size_t bytes_transferred)
+        {
+            self->on_write_file(error_code, bytes_transferred);
+        });
+}
+
+#endif
+
+void FileTransfer::on_write_file(boost::system::error_code error_code, std::size_t bytes_transferred)
+{
+    if (error_code)
+    {
+        finish(error_code);
+        return;
+    }
+
+    bytes_transferred_ += bytes_transferred;
+    if (bytes_transferred > 0)
+        on_progress();
+
+    write_file();
+}
+
+void FileTransfer::on_progress()
+{
+    if (progress_handler_)
+        progress_handler_();
+}
+
+void FileTransfer::next_part()
+{
+    if (++part_i_ == kParts_.size())
+    {
+        finish({});
+        return;
+    }
+
+    write_head();
+}
+
+void FileTransfer::finish(boost::system::error_code error_code)
+{
+    boost::system::error_code close_error_code;
+    file_.close(close_error_code);
+
+    auto handler = std::move(handler_);
+    handler_ = nullptr;
+
+    if (handler)
+        handler(error_code, bytes_transferred_);
+}
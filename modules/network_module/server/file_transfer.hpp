@@ -0,0 +1,67 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <functional>
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core/file.hpp>
+
+// Writes a response whose payload lives in a file. On Linux the file bytes
+// are copied to the socket by the kernel (sendfile), elsewhere they go through
+// one fixed size buffer, so memory per transfer doesn't depend on the file size
+class FileTransfer : public std::enable_shared_from_this<FileTransfer>
+{
+public:
+    struct Part
+    {
+        std::string head_; // Bytes written before the file range (status line, headers, part headers)
+        std::uint64_t offset_{0};
+        std::uint64_t size_{0};
+    };
+
+    typedef std::function<void(boost::system::error_code, std::size_t)> CompletionHandler;
+    // Called whenever bytes are written, the owner of the socket restarts its deadline
+    typedef std::function<void()> ProgressHandler;
+
+    FileTransfer() = delete;
+    FileTransfer(boost::asio::ip::tcp::socket &socket,
+                 boost::beast::file file,
+                 std::vector<Part> parts);
+    ~FileTransfer() = default;
+
+    void start(CompletionHandler handler,
+               ProgressHandler progress_handler);
+
+private:
+    void write_head();
+    void on_write_head(boost::system::error_code error_code, std::size_t bytes_transferred);
+
+    void write_file();
+    void on_write_file(boost::system::error_code error_code, std::size_t bytes_transferred);
+
+    void on_progress();
+    void next_part();
+    void finish(boost::system::error_code error_code);
+
+private:
+    boost::asio::ip::tcp::socket &socket_;
+    boost::beast::file file_;
+
+    const std::vector<Part> kParts_;
+    std::size_t part_i_{0};
+    std::uint64_t part_offset_{0};
+    std::uint64_t part_left_{0};
+
+    std::size_t bytes_transferred_{0};
+
+    CompletionHandler handler_;
+    ProgressHandler progress_handler_;
+
+#ifndef __linux__
+    std::array<char, 64 * 1024> buffer_;
+#endif
+};
@@ -0,0 +1,243 @@
+#include "file_upload.hpp"
+
+#include <random>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/beast/http/error.hpp>
+
+#include "easylogging++.h"
+
+namespace
+{
+    // Socket reads and file writes are done by pieces of this size
+    const std::size_t kChunkSize{256 * 1024};
+
+    std::filesystem::path make_temporary_path(const std::filesystem::path &file_path)
+    {
+        thread_local std::mt19937_64 generator{std::random_device{}()};
+
+        std::ostringstream string_stream;
+        string_stream << '.' << file_path.filename().string() << ".upload-"
+                      << std::hex << std::setfill('0') << std::setw(16) << generator();
+
+        return file_path.parent_path() / string_stream.str();
+    }
+}
+
+FileUpload::FileUpload(boost::asio::ip::tcp::socket &socket,
+                       boost::beast::flat_buffer &buffer,
+                       boost::beast::http::request_parser<boost::beast::http::empty_body> &&header_parser,
+                       std::filesystem::path file_path,
+                       const std::uint64_t &max_size,
+                       const int &idle_timeout_sec)
+    : socket_(socket),
+      session_buffer_(buffer),
+      parser_(std::move(header_parser)),
+      kFilePath_(std::move(file_path)),
+      input_(kChunkSize),
+      output_(kChunkSize),
+      kIdleTimeoutSec_(idle_timeout_sec),
+      timer_(socket.get_executor())
+{
+    parser_.body_limit(max_size);
+}
+
+void FileUpload::start(CompletionHandler handler)
+{
+    handler_ = std::move(handler);
+
+    std::error_code error_code;
+    result_.is_created_ = !std::filesystem::exists(kFilePath_, error_code);
+
+    std::filesystem::create_directories(kFilePath_.parent_path(), error_code);
+
+    temporary_path_ = make_temporary_path(kFilePath_);
+
+    boost::system::error_code file_error_code;
+    file_.open(temporary_path_.string().c_str(), boost::beast::file_mode::write, file_error_code);
+    if (file_error_code)
+    {
+        LOG(ERROR) << "Can't create \"" << temporary_path_.string() << "\" - " << file_error_code.message();
+        finish(Status::kStorageError);
+        return;
+    }
+
+    // Body bytes which came with the header
+    const auto kBuffered = boost::asio::buffer_copy(input_.prepare(session_buffer_.size()), session_buffer_.data());
+    input_.commit(kBuffered);
+    session_buffer_.consume(kBuffered);
+
+    const auto kStatus = consume();
+    if (kStatus != Status::kDone)
+    {
+        finish(kStatus);
+        return;
+    }
+
+    if (parser_.is_done())
+    {
+        finish(commit());
+        return;
+    }
+
+    read();
+}
+
+void FileUpload::read()
+{
+    // A body of known length is never read past its end,
+    // the next pipelined request stays in the socket
+    std::size_t read_size = input_.max_size() - input_.size();
+
+    const auto kRemaining = parser_.content_length_remaining();
+    if (kRemaining && (*kRemaining < read_size))
+        read_size = static_cast<std::size_t>(*kRemaining);
+
+    // Rearming cancels the previous wait
+    timer_.expires_after(std::chrono::seconds(kIdleTimeoutSec_));
+    timer_.async_wait([self = shared_from_this()](boost::system::error_code error_code)
+                      {
+                          if (error_code)
+                              return;
+
+                          LOG(DEBUG) << "Upload of \"" << self->kFilePath_.string() << "\" timed out";
+                          self->socket_.close(error_code); });
+
+    socket_.async_read_some(input_.prepare(std::max<std::size_t>(read_size, 1)),
+                            [self = shared_from_this()](boost::system::error_code error_code, std::size_t bytes_transferred)
+                            { self->on_read(error_code, bytes_transferred); });
+}
+
+void FileUpload::on_read(boost::system::error_code error_code, std::size_t bytes_transferred)
+{
+    if (error_code)
+    {
+        if (error_code != boost::asio::error::operation_aborted)
+            LOG(DEBUG) << "Upload of \"" << kFilePath_.string() << "\" is broken - " << error_code.message();
+
+        finish(Status::kConnectionError);
+        return;
+    }
+
+    input_.commit(bytes_transferred);
+
+    const auto kStatus = consume();
+    if (kStatus != Status::kDone)
+    {
+        finish(kStatus);
+        return;
+    }
+
+    if (parser_.is_done())
+    {
+        finish(commit());
+        return;
+    }
+
+    read();
+}
+
+FileUpload::Status FileUpload::consume()
+{
+    while ((input_.size() > 0) && !parser_.is_done())
+    {
+        auto &body = parser_.get().body();
+        body.data = output_.data();
+        body.size = output_.size();
+        body.more = true;
+
+        boost::system::error_code error_code;
+        const auto kUsed = parser_.put(input_.data(), error_code);
+        input_.consume(kUsed);
+
+        const auto kParsed = output_.size() - body.size;
+        if (kParsed > 0)
+        {
+            file_.write(output_.data(), kParsed, error_code);
+            if (error_code)
+            {
+                LOG(ERROR) << "Can't write \"" << temporary_path_.string() << "\" - " << error_code.message();
+                return Status::kStorageError;
+            }
+
+            crc_.process_bytes(output_.data(), kParsed);
+            result_.size_ += kParsed;
+            continue;
+        }
+
+        if (error_code == boost::beast::http::error::need_more)
+            break;
+
+        if (error_code && (error_code != boost::beast::http::error::need_buffer))
+        {
+            LOG(DEBUG) << "Upload of \"" << kFilePath_.string() << "\" is rejected - " << error_code.message();
+            return (error_code == boost::beast::http::error::body_limit) ? Status::kTooLarge : Status::kBadRequest;
+        }
+
+        if (kUsed == 0)
+            break;
+    }
+
+    return Status::kDone;
+}
+
+FileUpload::Status FileUpload::commit()
+{
+    boost::system::error_code error_code;
+    file_.close(error_code);
+    if (error_code)
+    {
+        LOG(ERROR) << "Can't close \"" << temporary_path_.string() << "\" - " << error_code.message();
+        return Status::kStorageError;
+    }
+
+    std::error_code rename_error_code;
+    std::filesystem::rename(temporary_path_, kFilePath_, rename_error_code);
+    if (rename_error_code)
+    {
+        LOG(ERROR) << "Can't rename \"" << temporary_path_.string() << "\" - " << rename_error_code.message();
+        return Status::kStorageError;
+    }
+
+    temporary_path_.clear();
+    result_.crc32_ = crc_.checksum();
+
+    // Bytes of the next pipelined request belong to the session. Only a chunked
+    // body can be read past its end, when they don't fit the connection
+    // is not read anymore and is closed after the response
+    if (input_.size() > session_buffer_.max_size() - session_buffer_.size())
+    {
+        LOG(WARNING) << "Pipelined request after the upload of \"" << kFilePath_.string() << "\" is too big";
+
+        boost::system::error_code shutdown_error_code;
+        socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_receive, shutdown_error_code);
+    }
+    else if (input_.size() > 0)
+    {
+        const auto kCopied = boost::asio::buffer_copy(session_buffer_.prepare(input_.size()), input_.data());
+        session_buffer_.commit(kCopied);
+    }
+
+    return Status::kDone;
+}
+
+void FileUpload::finish(const Status &status)
+{
+    timer_.cancel();
+
+    if (!temporary_path_.empty())
+    {
+        boost::system::error_code error_code;
+        file_.close(error_code);
+
+        std::error_code remove_error_code;
+        std::filesystem::remove(temporary_path_, remove_error_code);
+    }
+
+    auto handler = std::move(handler_);
+    if (handler)
+        handler(status, result_);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <filesystem>
+
+#include <boost/crc.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/beast/core/file.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http/parser.hpp>
+#include <boost/beast/http/empty_body.hpp>
+#include <boost/beast/http/buffer_body.hpp>
+
+// Reads a request body into a file. The body is parsed chunk by chunk
+// through fixed size buffers into a temporary file next to the target, which
+// replaces the target only after the whole body is received, so memory per
+// upload doesn't depend on the body size and readers never see a partial file
+class FileUpload : public std::enable_shared_from_this<FileUpload>
+{
+public:
+    enum class Status
+    {
+        kDone,
+        kTooLarge,       // Body is over the limit
+        kBadRequest,     // Body is malformed
+        kStorageError,   // File can't be created or written
+        kConnectionError // Connection is broken, nothing can be answered
+    };
+
+    struct Result
+    {
+        std::uint64_t size_{0};
+        std::uint32_t crc32_{0};
+        bool is_created_{false}; // File didn't exist before
+    };
+
+    typedef std::function<void(Status, const Result &)> CompletionHandler;
+
+    FileUpload() = delete;
+    // Header of the request has to be parsed already. Body bytes read with it
+    // are taken from buffer, bytes read after the body are given back to it.
+    // The connection is closed when no body bytes come for idle_timeout_sec
+    FileUpload(boost::asio::ip::tcp::socket &socket,
+               boost::beast::flat_buffer &buffer,
+               boost::beast::http::request_parser<boost::beast::http::empty_body> &&header_parser,
+               std::filesystem::path file_path,
+               const std::uint64_t &max_size,
+               const int &idle_timeout_sec);
+    ~FileUpload() = default;
+
+    void start(CompletionHandler handler);
+
+private:
+    void read();
+    void on_read(boost::system::error_code error_code, std::size_t bytes_transferred);
+
+    // Feeds input_ to the parser and the parsed body to the file
+    Status consume();
+    Status commit();
+
+    void finish(const Status &status);
+
+private:
+    boost::asio::ip::tcp::socket &socket_;
+    boost::beast::flat_buffer &session_buffer_;
+
+    boost::beast::http::request_parser<boost::beast::http::buffer_body> parser_;
+
+    const std::filesystem::path kFilePath_;
+    std::filesystem::path temporary_path_;
+    boost::beast::file file_;
+
+    boost::beast::flat_buffer input_;
+    std::vector<char> output_;
+
+    boost::crc_32_type crc_;
+    Result result_;
+
+    const int kIdleTimeoutSec_;
+    boost::asio::steady_timer timer_;
+
+    CompletionHandler handler_;
+};
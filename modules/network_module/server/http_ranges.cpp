@@ -0,0 +1,167 @@
+#include "http_ranges.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+    boost::beast::string_view trim(boost::beast::string_view value)
+    {
+        while (!value.empty() && (value.front() == ' ' || value.front() == '\t'))
+            value.remove_prefix(1);
+        while (!value.empty() && (value.back() == ' ' || value.back() == '\t'))
+            value.remove_suffix(1);
+
+        return value;
+    }
+
+    // Too big numbers saturate, they are still valid for the header syntax
+    bool parse_number(boost::beast::string_view value, std::uint64_t &number)
+    {
+        if (value.empty())
+            return false;
+
+        number = 0;
+
+        for (const auto &symbol : value)
+        {
+            if (symbol < '0' || symbol > '9')
+                return false;
+
+            const std::uint64_t kDigit = symbol - '0';
+            if (number > (std::numeric_limits<std::uint64_t>::max() - kDigit) / 10)
+                number = std::numeric_limits<std::uint64_t>::max();
+            else
+                number = number * 10 + kDigit;
+        }
+
+        return true;
+    }
+
+    void merge_overlapping(std::vector<HttpRanges::ByteRange> &ranges)
+    {
+        std::sort(ranges.begin(), ranges.end(),
+                  [](const HttpRanges::ByteRange &left, const HttpRanges::ByteRange &right)
+                  { return left.offset_ < right.offset_; });
+
+        std::size_t last_i = 0;
+        for (std::size_t range_i = 1; range_i < ranges.size(); ++range_i)
+        {
+            auto &last = ranges[last_i];
+            const auto &kCurrent = ranges[range_i];
+
+            if (kCurrent.offset_ <= last.offset_ + last.size_)
+            {
+                last.size_ = std::max(last.offset_ + last.size_, kCurrent.offset_ + kCurrent.size_) - last.offset_;
+                continue;
+            }
+
+            ranges[++last_i] = kCurrent;
+        }
+
+        ranges.resize(last_i + 1);
+    }
+}
+
+const std::size_t HttpRanges::kMaxRangesNumber{64};
+
+bool HttpRanges::parse(boost::beast::string_view header,
+                       const std::uint64_t &full_size,
+                       std::vector<ByteRange> &ranges)
+{
+    static const boost::beast::string_view kUnit("bytes=");
+
+    ranges.clear();
+
+    header = trim(header);
+    if ((header.size() < kUnit.size()) ||
+        !boost::beast::iequals(header.substr(0, kUnit.size()), kUnit))
+        return false;
+
+    header.remove_prefix(kUnit.size());
+
+    std::size_t specs_number = 0;
+    bool is_overlapped = false;
+
+    while (!header.empty())
+    {
+        const auto kSeparator = header.find(',');
+        const auto kSpec = trim(header.substr(0, kSeparator));
+
+        header.remove_prefix((kSeparator == boost::beast::string_view::npos) ? header.size() : kSeparator + 1);
+
+        // Empty list elements are allowed
+        if (kSpec.empty())
+            continue;
+
+        if (++specs_number > kMaxRangesNumber)
+            return false;
+
+        const auto kDash = kSpec.find('-');
+        if (kDash == boost::beast::string_view::npos)
+            return false;
+
+        const auto kFirst = trim(kSpec.substr(0, kDash));
+        const auto kLast = trim(kSpec.substr(kDash + 1));
+
+        ByteRange range;
+
+        if (kFirst.empty())
+        {
+            // Suffix range "-500", the last 500 bytes
+            std::uint64_t suffix_size = 0;
+            if (!parse_number(kLast, suffix_size))
+                return false;
+
+            if ((suffix_size == 0) || (full_size == 0))
+                continue;
+
+            range.size_ = std::min(suffix_size, full_size);
+            range.offset_ = full_size - range.size_;
+        }
+        else
+        {
+            std::uint64_t first = 0;
+            if (!parse_number(kFirst, first))
+                return false;
+
+            std::uint64_t last = std::numeric_limits<std::uint64_t>::max();
+            if (!kLast.empty() && !parse_number(kLast, last))
+                return false;
+
+            if (last < first)
+                return false;
+
+            if (first >= full_size)
+                continue;
+
+            range.offset_ = first;
+            range.size_ = std::min(last, full_size - 1) - first + 1;
+        }
+
+        for (const auto &kPrevious : ranges)
+        {
+            if ((range.offset_ < kPrevious.offset_ + kPrevious.size_) &&
+                (kPrevious.offset_ < range.offset_ + range.size_))
+                is_overlapped = true;
+        }
+
+        ranges.push_back(range);
+    }
+
+    if (specs_number == 0)
+        return false;
+
+    if (is_overlapped)
+        merge_overlapping(ranges);
+
+    return true;
+}
+
+std::string HttpRanges::to_content_range(const ByteRange &range,
+                                         const std::uint64_t &full_size)
+{
+    return "bytes " + std::to_string(range.offset_) + "-" +
+           std::to_string(range.offset_ + range.size_ - 1) + "/" +
+           std::to_string(full_size);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include <boost/beast/core/string.hpp>
+
+// Byte ranges of the Range request header (RFC 7233)
+class HttpRanges
+{
+public:
+    struct ByteRange
+    {
+        std::uint64_t offset_{0};
+        std::uint64_t size_{0};
+
+        bool operator==(const ByteRange &other) const
+        {
+            return (offset_ == other.offset_) && (size_ == other.size_);
+        }
+    };
+
+    HttpRanges() = delete;
+
+    // Fills ranges with the satisfiable ranges of a representation of
+    // full_size bytes. Overlapping ranges are merged. Returns false when
+    // the header has to be ignored (not a bytes range, malformed, too many ranges),
+    // true with empty ranges means nothing is satisfiable (416)
+    static bool parse(boost::beast::string_view header,
+                      const std::uint64_t &full_size,
+                      std::vector<ByteRange> &ranges);
+
+    // "bytes 0-499/1234"
+    static std::string to_content_range(const ByteRange &range,
+                                        const std::uint64_t &full_size);
+
+    static const std::size_t kMaxRangesNumber;
+};
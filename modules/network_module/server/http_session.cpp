@@ -14,8 +14,14 @@
 #include <ctime>
 #include <memory>
 #include <string>
+#include <sstream>
+#include <iomanip>
+#include <random>
+#include <cctype>
 
 #include "websocket_session.hpp"
+#include "file_transfer.hpp"
+#include "http_ranges.hpp"
 
 namespace
 {
@@ -23,18 +29,132 @@ namespace
     {
         return !(error_code == boost::asio::error::operation_aborted);
     }
+
+    // If-None-Match holds "*" or a comma separated list of entity tags,
+    // which are compared weakly (RFC 7232, 3.2)
+    bool is_etag_matched(boost::beast::string_view if_none_match,
+                         boost::beast::string_view etag)
+    {
+        static const boost::beast::string_view kWeakPrefix("W/");
+
+        if (etag.starts_with(kWeakPrefix))
+            etag.remove_prefix(kWeakPrefix.size());
+
+        while (!if_none_match.empty())
+        {
+            const auto kSeparator = if_none_match.find(',');
+            auto candidate = if_none_match.substr(0, kSeparator);
+
+            if_none_match.remove_prefix((kSeparator == boost::beast::string_view::npos)
+                                            ? if_none_match.size()
+                                            : kSeparator + 1);
+
+            while (!candidate.empty() && (candidate.front() == ' ' || candidate.front() == '\t'))
+                candidate.remove_prefix(1);
+            while (!candidate.empty() && (candidate.back() == ' ' || candidate.back() == '\t'))
+                candidate.remove_suffix(1);
+
+            if (candidate == "*")
+                return true;
+
+            if (candidate.starts_with(kWeakPrefix))
+                candidate.remove_prefix(kWeakPrefix.size());
+
+            if (candidate == etag)
+                return true;
+        }
+
+        return false;
+    }
+
+    // Maps a request target under the storage url to a path under the storage root.
+    // Percent-escapes are decoded, targets leaving the root are rejected
+    bool get_storage_path(boost::beast::string_view target,
+                          const std::string &url_prefix,
+                          const std::string &root_path,
+                          std::filesystem::path &path)
+    {
+        if (root_path.empty() || url_prefix.empty() || !target.starts_with(url_prefix))
+            return false;
+
+        target.remove_prefix(url_prefix.size());
+        target = target.substr(0, target.find('?'));
+
+        std::string relative_path;
+        relative_path.reserve(target.size());
+
+        for (std::size_t i = 0; i < target.size(); ++i)
+        {
+            if ((target[i] == '%') && (i + 2 < target.size()) &&
+                std::isxdigit(static_cast<unsigned char>(target[i + 1])) &&
+                std::isxdigit(static_cast<unsigned char>(target[i + 2])))
+            {
+                relative_path.push_back(static_cast<char>(std::stoi(std::string(target.substr(i + 1, 2)), nullptr, 16)));
+                i += 2;
+                continue;
+            }
+
+            relative_path.push_back(target[i]);
+        }
+
+        if (relative_path.empty() || (relative_path.find('\0') != std::string::npos))
+            return false;
+
+        const std::filesystem::path kRelativePath(relative_path);
+        if (kRelativePath.has_root_path())
+            return false;
+
+        for (const auto &segment : kRelativePath)
+        {
+            if (segment == "..")
+                return false;
+        }
+
+        path = std::filesystem::path(root_path) / kRelativePath;
+        return true;
+    }
+
+    // Bodies of requests other than storage uploads are kept in memory,
+    // the limit is the default one of beast request parsers
+    const std::uint64_t kMaxBodySize{1024 * 1024};
+
+    std::uint64_t get_max_upload_size(const network_module::server::Server::Config::HttpSettings &settings)
+    {
+        return (settings.max_upload_size_mb_ > 0) ? static_cast<std::uint64_t>(settings.max_upload_size_mb_) * 1024 * 1024 : 0;
+    }
+
+    // Strong validator of a storage file, changes with its size and modification time
+    std::string make_file_etag(const std::filesystem::path &file_path,
+                               const std::uint64_t &size)
+    {
+        std::error_code error_code;
+        const auto kModificationTime = std::filesystem::last_write_time(file_path, error_code);
+
+        std::ostringstream string_stream;
+        string_stream << '"' << std::hex << size << '-'
+                      << kModificationTime.time_since_epoch().count() << '"';
+        return string_stream.str();
+    }
+
+    std::string make_boundary()
+    {
+        thread_local std::mt19937_64 generator{std::random_device{}()};
+
+        std::ostringstream string_stream;
+        string_stream << std::hex << std::setfill('0') << std::setw(16) << generator();
+        return string_stream.str();
+    }
 }
 
 HttpSession::HttpSession(boost::asio::ip::tcp::socket socket,
                          SessionsManager &session_manager,
-                         boost::asio::io_context &io_context,
-                         const network_module::server::Server::Config::Callbacks callbacks)
-    : socket_(std::move(socket)),
-      kCallbacks_(callbacks),
-      deadline_(socket_.get_executor(),
-                std::chrono::seconds(60)),
-      session_manager_(session_manager),
-      io_context_(io_context)
+                         TimerWheel &timer_wheel,
+                         SessionContextPtr context)
+    : kContext_(std::move(context)),
+      socket_(std::move(socket)),
+      timer_wheel_(timer_wheel),
+      deadline_(timer_wheel),
+      session_manager_(session_manager)
 {
 }
 
@@ -44,35 +164,143 @@ HttpSession::~HttpSession()
 
 void HttpSession::start()
 {
+    // The wheel doesn't keep the session alive, an expired deadline
+    // of a finished session is ignored
+    deadline_.set_handler([weak_self = weak_from_this()](const std::uint64_t &generation)
+                          {
+                              const auto kSelf = weak_self.lock();
+                              if (!kSelf)
+                                  return;
+
+                              boost::asio::post(kSelf->socket_.get_executor(),
+                                                [kSelf, generation]()
+                                                {
+                                                    kSelf->on_deadline(generation);
+                                                }); });
+
     read();
-    check_deadline();
 }
 
 void HttpSession::read()
 {
-    boost::beast::http::async_read(
+    // Pipelined requests are already in buffer_ and are parsed one by one,
+    // so responses go out in the order the requests came in
+    request_ = {};
+
+    // The header goes first, the body is read depending on the target
+    header_parser_.emplace();
+    header_parser_->body_limit(std::max(get_max_upload_size(kContext_->http_settings_), kMaxBodySize));
+
+    // Limits only the wait for a request, it is cancelled once the request is read
+    deadline_.expires_after(std::chrono::seconds((requests_number_ == 0)
+                                                     ? kContext_->http_settings_.request_timeout_sec_
+                                                     : kContext_->http_settings_.keep_alive_timeout_sec_));
+
+    boost::beast::http::async_read_header(
         socket_,
         buffer_,
-        request_,
-        boost::bind(&HttpSession::on_read,
-                    this,
+        *header_parser_,
+        boost::bind(&HttpSession::on_read_header,
+                    shared_from_this(),
                     boost::asio::placeholders::error,
                     boost::asio::placeholders::bytes_transferred));
 }
 
-void HttpSession::on_read(boost::beast::error_code error_code,
-                          std::size_t bytes_transferred)
+void HttpSession::on_read_header(boost::beast::error_code error_code,
+                                 std::size_t)
 {
-    if (error_code)
+    if (is_read_failed(error_code))
+        return;
+
+    const auto &kHeader = header_parser_->get();
+
+    if ((kHeader.method() == boost::beast::http::verb::put) ||
+        (kHeader.method() == boost::beast::http::verb::post))
     {
-        LOG(ERROR) << error_code.value() << " : " << error_code.message();
+        std::filesystem::path file_path;
+        if (get_storage_path(kHeader.target(),
+                             kContext_->http_settings_.storage_url_prefix_,
+                             kContext_->http_settings_.storage_root_path_,
+                             file_path))
+        {
+            read_body([this, file_path]()
+                      { upload(file_path); });
+            return;
+        }
+    }
 
-        if (is_error_important(error_code))
-            socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_send, error_code);
+    // Other bodies are kept in memory
+    const auto kContentLength = header_parser_->content_length();
+    if (kContentLength && (*kContentLength > kMaxBodySize))
+    {
+        ++requests_number_;
+        response_ = {};
+        request_.base() = kHeader.base();
+        request_.keep_alive(false);
+        write_text(boost::beast::http::status::payload_too_large, "Payload too large");
+        return;
+    }
 
+    body_parser_.emplace(std::move(*header_parser_));
+    body_parser_->body_limit(kMaxBodySize);
+    header_parser_.reset();
+
+    read_body([this]()
+              { boost::beast::http::async_read(
+                    socket_,
+                    buffer_,
+                    *body_parser_,
+                    boost::bind(&HttpSession::on_read,
+                                shared_from_this(),
+                                boost::asio::placeholders::error,
+                                boost::asio::placeholders::bytes_transferred)); });
+}
+
+void HttpSession::read_body(std::function<void()> read)
+{
+    const auto &kHeader = body_parser_ ? body_parser_->get().base() : header_parser_->get().base();
+
+    if ((kHeader.version() < 11) ||
+        !boost::beast::iequals(kHeader[boost::beast::http::field::expect], "100-continue"))
+    {
+        read();
         return;
     }
 
+    // The client waits for it before sending the body
+    static const std::string kContinueResponse{"HTTP/1.1 100 Continue\r\n\r\n"};
+
+    boost::asio::async_write(socket_,
+                             boost::asio::buffer(kContinueResponse),
+                             [self = shared_from_this(), read = std::move(read)](boost::beast::error_code error_code, std::size_t)
+                             {
+                                 if (error_code)
+                                 {
+                                     if (is_error_important(error_code))
+                                         LOG(ERROR) << error_code.value() << " : " << error_code.message();
+
+                                     self->close();
+                                     return;
+                                 }
+
+                                 read();
+                             });
+}
+
+void HttpSession::on_read(boost::beast::error_code error_code,
+                          std::size_t)
+{
+    if (is_read_failed(error_code))
+        return;
+
+    request_ = body_parser_->release();
+    body_parser_.reset();
+
+    ++requests_number_;
+
+    // Writing the response has its own deadline
+    deadline_.cancel();
+
     if (boost::beast::websocket::is_upgrade(request_))
     {
         LOG(DEBUG) << "Request to update to websocket("
@@ -83,9 +311,9 @@ void HttpSession::on_read(boost::beast::error_code error_code,
 
         auto session = std::make_shared<WebSocketSession>(std::move(socket_),
                                                           session_manager_,
-                                                          io_context_,
-                                                          kCallbacks_.web_sockets_callbacks_);
-        session->start(std::move(request_), session);
+                                                          timer_wheel_,
+                                                          kContext_);
+        session->start(std::move(request_));
 
         return;
     }
@@ -93,93 +321,536 @@ void HttpSession::on_read(boost::beast::error_code error_code,
     do_request_responce();
 }
 
+bool HttpSession::is_read_failed(const boost::beast::error_code &error_code)
+{
+    if (error_code == boost::beast::http::error::end_of_stream)
+    {
+        LOG(DEBUG) << "Connection closed by client after " << requests_number_ << " request(s)";
+        close();
+        return true;
+    }
+
+    if (error_code == boost::beast::http::error::body_limit)
+    {
+        if (body_parser_)
+            request_.base() = body_parser_->get().base();
+        else if (header_parser_)
+            request_.base() = header_parser_->get().base();
+
+        ++requests_number_;
+        response_ = {};
+        request_.keep_alive(false);
+        write_text(boost::beast::http::status::payload_too_large, "Payload too large");
+        return true;
+    }
+
+    if (error_code)
+    {
+        if (is_error_important(error_code))
+        {
+            LOG(ERROR) << error_code.value() << " : " << error_code.message();
+            close();
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+void HttpSession::upload(const std::filesystem::path &file_path)
+{
+    ++requests_number_;
+
+    response_ = {};
+    request_.base() = header_parser_->get().base();
+
+    // The upload has its own idle timeout
+    deadline_.cancel();
+
+    auto file_upload = std::make_shared<FileUpload>(socket_,
+                                                    buffer_,
+                                                    std::move(*header_parser_),
+                                                    file_path,
+                                                    get_max_upload_size(kContext_->http_settings_),
+                                                    kContext_->http_settings_.request_timeout_sec_);
+    header_parser_.reset();
+
+    file_upload->start(
+        [self = shared_from_this()](FileUpload::Status status, const FileUpload::Result &result)
+        {
+            self->on_upload(status, result);
+        });
+}
+
+void HttpSession::on_upload(const FileUpload::Status &status,
+                            const FileUpload::Result &result)
+{
+    switch (status)
+    {
+
+    case FileUpload::Status::kDone:
+    {
+        std::ostringstream string_stream;
+        string_stream << "{\"size\":" << result.size_ << ",\"crc32\":\""
+                      << std::hex << std::setfill('0') << std::setw(8) << result.crc32_ << "\"}";
+
+        network_module::HttpResponse response;
+        response.status_ = static_cast<unsigned>(result.is_created_ ? boost::beast::http::status::created
+                                                                    : boost::beast::http::status::ok);
+        response.content_type_ = "application/json";
+        response.body_ = string_stream.str();
+
+        write_response(response);
+        break;
+    }
+    case FileUpload::Status::kConnectionError:
+    {
+        close();
+        break;
+    }
+    default:
+    {
+        // The rest of the body isn't read, the connection can't be reused
+        request_.keep_alive(false);
+
+        if (status == FileUpload::Status::kTooLarge)
+            write_text(boost::beast::http::status::payload_too_large, "Payload too large");
+        else if (status == FileUpload::Status::kBadRequest)
+            write_text(boost::beast::http::status::bad_request, "Bad request");
+        else
+            write_text(boost::beast::http::status::internal_server_error, "Can't store the file");
+
+        break;
+    }
+    }
+}
+
 void HttpSession::do_request_responce()
 {
-    response_.version(request_.version());
-    response_.keep_alive(false);
+    response_ = {};
+
+    const std::string_view kTarget(request_.target().data(), request_.target().size());
 
-    switch (request_.method())
+    if (request_.method() == boost::beast::http::verb::get)
     {
+        std::filesystem::path file_path;
+        if (get_storage_path(request_.target(),
+                             kContext_->http_settings_.storage_url_prefix_,
+                             kContext_->http_settings_.storage_root_path_,
+                             file_path))
+        {
+            if (!write_file(file_path))
+                write_not_found();
+
+            return;
+        }
+    }
 
-    case boost::beast::http::verb::get:
+    const auto kQueryPosition = kTarget.find('?');
+
+    route_request_.method_ = std::string_view(request_.method_string().data(), request_.method_string().size());
+    route_request_.target_ = kTarget;
+    route_request_.path_ = kTarget.substr(0, kQueryPosition);
+    route_request_.query_ = (kQueryPosition == std::string_view::npos) ? std::string_view() : kTarget.substr(kQueryPosition + 1);
+
+    const Router::Handler *handler = nullptr;
+
+    switch (kContext_->router_.find(request_.method(), route_request_.path_, route_request_.parameters_, handler))
     {
-        response_.result(boost::beast::http::status::ok);
-        response_.set(boost::beast::http::field::server, "Beast");
-        create_response();
+
+    case Router::Status::kFound:
+    {
+        write_handler_result(boost::beast::http::status::ok, *handler);
+        break;
+    }
+    case Router::Status::kMethodNotAllowed:
+    {
+        response_.set(boost::beast::http::field::allow, kContext_->router_.get_allowed_methods(route_request_.path_));
+        write_text(boost::beast::http::status::method_not_allowed,
+                   "Invalid request-method '" + std::string(request_.method_string()) + "'");
         break;
     }
     default:
     {
-        response_.result(boost::beast::http::status::bad_request);
-        response_.set(boost::beast::http::field::content_type, "text/plain");
-        boost::beast::ostream(response_.body())
-            << "Invalid request-method '"
-            << std::string(request_.method_string())
-            << "'";
+        write_not_found();
         break;
     }
     }
+}
+
+void HttpSession::write_handler_result(const boost::beast::http::status &status,
+                                       const Router::Handler &handler)
+{
+    if (handler.content_callback_)
+    {
+        auto content = handler.content_callback_();
+        if (content)
+            write_content(status, std::move(content));
+        else if (status != boost::beast::http::status::not_found)
+            write_not_found();
+        else
+            write_text(boost::beast::http::status::not_found, "Not found");
+
+        return;
+    }
+
+    if (handler.async_callback_ || handler.is_blocking_)
+    {
+        call_async_handler(handler);
+        return;
+    }
+
+    if (handler.request_callback_)
+    {
+        write_callback_result(status, handler.request_callback_(route_request_));
+        return;
+    }
 
-    write();
+    write_callback_result(status, handler.callback_());
 }
 
-void HttpSession::create_response()
+void HttpSession::write_not_found()
 {
-    response_.set(boost::beast::http::field::content_type, "text/html");
+    const auto *kHandler = kContext_->router_.get_not_found_handler();
+    if (!kHandler)
+    {
+        write_text(boost::beast::http::status::not_found, "Not found");
+        return;
+    }
+
+    write_handler_result(boost::beast::http::status::not_found, *kHandler);
+}
 
-    const auto kPosition = kCallbacks_.http_callbacks_.find(static_cast<network_module::Url>(request_.target()));
-    if (kPosition != kCallbacks_.http_callbacks_.end())
+void HttpSession::call_async_handler(const Router::Handler &handler)
+{
+    // request_ isn't touched until the response is written,
+    // so the views stay valid while the handler works
+    route_request_.headers_.clear();
+    for (const auto &kField : request_)
     {
-        boost::beast::ostream(response_.body()) << kPosition->second();
+        route_request_.headers_.emplace_back(std::string_view(kField.name_string().data(), kField.name_string().size()),
+                                             std::string_view(kField.value().data(), kField.value().size()));
     }
+    route_request_.body_ = request_.body();
+
+    // A handler which never responds doesn't hold the connection forever
+    deadline_.expires_after(std::chrono::seconds(kContext_->http_settings_.request_timeout_sec_));
+
+    auto self = shared_from_this();
+
+    network_module::HttpResponder responder = [self](network_module::HttpResponse response)
+    {
+        boost::asio::post(self->socket_.get_executor(),
+                          [self, response = std::move(response)]()
+                          { self->write_response(response); });
+    };
+
+    auto call = [self, &handler, responder = std::move(responder)]()
+    {
+        if (handler.async_callback_)
+        {
+            handler.async_callback_(self->route_request_, responder);
+            return;
+        }
+
+        network_module::HttpResponse response;
+        response.body_ = handler.request_callback_ ? handler.request_callback_(self->route_request_)
+                                                   : handler.callback_();
+        responder(std::move(response));
+    };
+
+    if (handler.is_blocking_ && kContext_->blocking_pool_)
+        boost::asio::post(*kContext_->blocking_pool_, std::move(call));
     else
+        call();
+}
+
+void HttpSession::write_response(const network_module::HttpResponse &response)
+{
+    if ((response.status_ < 100) || (response.status_ > 599))
     {
-        boost::beast::ostream(response_.body()) << kCallbacks_.http_callbacks_.at(network_module::Urls::kPageNotFound_)();
+        LOG(ERROR) << "Invalid status " << response.status_ << " of \"" << route_request_.target_ << "\"";
+        write_text(boost::beast::http::status::internal_server_error, "Internal server error");
+        return;
     }
+
+    response_.version(request_.version());
+    response_.keep_alive(is_keep_alive());
+    response_.result(response.status_);
+    response_.set(boost::beast::http::field::server, "Beast");
+    response_.set(boost::beast::http::field::content_type, response.content_type_);
+
+    for (const auto &kHeader : response.headers_)
+        response_.set(kHeader.first, kHeader.second);
+
+    boost::beast::ostream(response_.body()) << response.body_;
+
+    response_.content_length(response_.body().size());
+
+    write(response_);
 }
 
-void HttpSession::write()
+void HttpSession::write_callback_result(const boost::beast::http::status &status,
+                                        const std::string &body)
 {
+    response_.version(request_.version());
+    response_.keep_alive(is_keep_alive());
+    response_.result(status);
+    response_.set(boost::beast::http::field::server, "Beast");
+    response_.set(boost::beast::http::field::content_type, "text/html");
+
+    boost::beast::ostream(response_.body()) << body;
+
     response_.content_length(response_.body().size());
 
+    write(response_);
+}
+
+void HttpSession::write_text(const boost::beast::http::status &status,
+                             const std::string &text)
+{
+    response_.version(request_.version());
+    response_.keep_alive(is_keep_alive());
+    response_.result(status);
+    response_.set(boost::beast::http::field::server, "Beast");
+    response_.set(boost::beast::http::field::content_type, "text/plain");
+
+    boost::beast::ostream(response_.body()) << text;
+
+    response_.content_length(response_.body().size());
+
+    write(response_);
+}
+
+void HttpSession::write_content(const boost::beast::http::status &status,
+                                network_module::HttpContentPtr content)
+{
+    // Holding the content keeps the bytes referenced by the span alive
+    // until the response is written
+    content_ = std::move(content);
+
+    content_response_ = {};
+    content_response_.version(request_.version());
+    content_response_.keep_alive(is_keep_alive());
+    content_response_.set(boost::beast::http::field::server, "Beast");
+    content_response_.set(boost::beast::http::field::etag, content_->etag_);
+
+    const auto kIfNoneMatch = request_[boost::beast::http::field::if_none_match];
+    if ((status == boost::beast::http::status::ok) &&
+        !kIfNoneMatch.empty() &&
+        is_etag_matched(kIfNoneMatch, content_->etag_))
+    {
+        content_response_.result(boost::beast::http::status::not_modified);
+        write(content_response_);
+        return;
+    }
+
+    content_response_.result(status);
+    content_response_.set(boost::beast::http::field::content_type, content_->content_type_);
+    content_response_.set(boost::beast::http::field::content_length, content_->content_length_);
+    content_response_.body() = {content_->body_.data(), content_->body_.size()};
+
+    write(content_response_);
+}
+
+bool HttpSession::write_file(const std::filesystem::path &file_path)
+{
+    std::error_code error_code;
+    if (!std::filesystem::is_regular_file(file_path, error_code))
+        return false;
+
+    boost::beast::error_code file_error_code;
+    boost::beast::file file;
+
+    file.open(file_path.string().c_str(), boost::beast::file_mode::scan, file_error_code);
+    if (file_error_code)
+    {
+        LOG(ERROR) << "Can't open \"" << file_path.string() << "\" - " << file_error_code.message();
+        return false;
+    }
+
+    const auto kSize = file.size(file_error_code);
+    if (file_error_code)
+    {
+        LOG(ERROR) << "Can't get size of \"" << file_path.string() << "\" - " << file_error_code.message();
+        return false;
+    }
+
+    const auto kEtag = make_file_etag(file_path, kSize);
+
+    boost::beast::http::response<boost::beast::http::empty_body> response{boost::beast::http::status::ok,
+                                                                          request_.version()};
+    response.keep_alive(is_keep_alive());
+    response.set(boost::beast::http::field::server, "Beast");
+    response.set(boost::beast::http::field::etag, kEtag);
+    response.set(boost::beast::http::field::accept_ranges, "bytes");
+
+    std::vector<FileTransfer::Part> parts;
+
+    const auto kIfNoneMatch = request_[boost::beast::http::field::if_none_match];
+    if (!kIfNoneMatch.empty() && is_etag_matched(kIfNoneMatch, kEtag))
+    {
+        response.result(boost::beast::http::status::not_modified);
+        parts.push_back(FileTransfer::Part{});
+    }
+    else
+    {
+        parts = make_file_parts(response, kEtag, kSize);
+    }
+
+    std::ostringstream header_stream;
+    header_stream << response.base();
+    parts.front().head_.insert(0, header_stream.str());
+
+    auto transfer = std::make_shared<FileTransfer>(socket_, std::move(file), std::move(parts));
+
+    // A big file takes long on a slow link, only a transfer making no progress is closed
+    deadline_.expires_after(std::chrono::seconds(kContext_->http_settings_.write_timeout_sec_));
+
+    transfer->start(boost::bind(&HttpSession::on_write,
+                                shared_from_this(),
+                                boost::asio::placeholders::error,
+                                boost::asio::placeholders::bytes_transferred,
+                                response.need_eof()),
+                    [self = shared_from_this()]()
+                    {
+                        self->deadline_.expires_after(std::chrono::seconds(self->kContext_->http_settings_.write_timeout_sec_));
+                    });
+    return true;
+}
+
+std::vector<FileTransfer::Part> HttpSession::make_file_parts(boost::beast::http::response<boost::beast::http::empty_body> &response,
+                                                             const std::string &etag,
+                                                             const std::uint64_t &size) const
+{
+    static const std::string kContentType("application/octet-stream");
+
+    // A stale If-Range validator means the client's copy changed, so the whole file is sent.
+    // Only strong validators match, weak ones and dates never equal our ETag
+    const auto kRange = request_[boost::beast::http::field::range];
+    const auto kIfRange = request_[boost::beast::http::field::if_range];
+
+    std::vector<HttpRanges::ByteRange> ranges;
+
+    if (kRange.empty() ||
+        (!kIfRange.empty() && (kIfRange != etag)) ||
+        !HttpRanges::parse(kRange, size, ranges))
+    {
+        response.set(boost::beast::http::field::content_type, kContentType);
+        response.content_length(size);
+        return {FileTransfer::Part{{}, 0, size}};
+    }
+
+    if (ranges.empty())
+    {
+        response.result(boost::beast::http::status::range_not_satisfiable);
+        response.set(boost::beast::http::field::content_range, "bytes */" + std::to_string(size));
+        response.content_length(0);
+        return {FileTransfer::Part{}};
+    }
+
+    response.result(boost::beast::http::status::partial_content);
+
+    if (ranges.size() == 1)
+    {
+        response.set(boost::beast::http::field::content_type, kContentType);
+        response.set(boost::beast::http::field::content_range, HttpRanges::to_content_range(ranges.front(), size));
+        response.content_length(ranges.front().size_);
+        return {FileTransfer::Part{{}, ranges.front().offset_, ranges.front().size_}};
+    }
+
+    // multipart/byteranges: every range is preceded by a boundary line and its own headers
+    const auto kBoundary = make_boundary();
+
+    std::vector<FileTransfer::Part> parts;
+    parts.reserve(ranges.size() + 1);
+
+    std::uint64_t content_length = 0;
+
+    for (const auto &kByteRange : ranges)
+    {
+        std::string head = (parts.empty() ? "" : "\r\n");
+        head += "--" + kBoundary + "\r\n" +
+                "Content-Type: " + kContentType + "\r\n" +
+                "Content-Range: " + HttpRanges::to_content_range(kByteRange, size) + "\r\n\r\n";
+
+        content_length += head.size() + kByteRange.size_;
+        parts.push_back({std::move(head), kByteRange.offset_, kByteRange.size_});
+    }
+
+    parts.push_back({"\r\n--" + kBoundary + "--\r\n", 0, 0});
+    content_length += parts.back().head_.size();
+
+    response.set(boost::beast::http::field::content_type, "multipart/byteranges; boundary=" + kBoundary);
+    response.content_length(content_length);
+
+    return parts;
+}
+
+bool HttpSession::is_keep_alive() const
+{
+    return request_.keep_alive() &&
+           (requests_number_ < kContext_->http_settings_.max_keep_alive_requests_);
+}
+
+template <class Body>
+void HttpSession::write(boost::beast::http::response<Body> &response)
+{
+    deadline_.expires_after(std::chrono::seconds(kContext_->http_settings_.write_timeout_sec_));
+
     boost::beast::http::async_write(
         socket_,
-        response_,
+        response,
         boost::bind(&HttpSession::on_write,
-                    this,
+                    shared_from_this(),
                     boost::asio::placeholders::error,
-                    boost::asio::placeholders::bytes_transferred));
+                    boost::asio::placeholders::bytes_transferred,
+                    response.need_eof()));
 }
 
 void HttpSession::on_write(boost::beast::error_code error_code,
-                           std::size_t bytes_transferred)
+                           std::size_t,
+                           bool is_need_eof)
 {
     if (error_code)
     {
-        LOG(ERROR) << error_code.value() << " : " << error_code.message();
-
         if (is_error_important(error_code))
-            socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_send, error_code);
+        {
+            LOG(ERROR) << error_code.value() << " : " << error_code.message();
+            close();
+        }
+
+        return;
     }
 
-    deadline_.cancel();
+    content_.reset();
+
+    if (is_need_eof)
+    {
+        close();
+        return;
+    }
+
+    read();
 }
 
-void HttpSession::check_deadline()
+void HttpSession::on_deadline(const std::uint64_t &generation)
 {
-    auto self = shared_from_this();
+    // Armed again or cancelled after the wheel fired it
+    if (!deadline_.is_expired(generation))
+        return;
 
-    deadline_.async_wait(
-        [self](boost::beast::error_code error_code)
-        {
-            if (error_code)
-            {
-                if (is_error_important(error_code))
-                    LOG(ERROR) << error_code.value() << " : " << error_code.message();
+    LOG(DEBUG) << "Deadline of the connection expired";
 
-                return;
-            }
+    boost::beast::error_code error_code;
+    socket_.close(error_code);
+}
 
-            self->socket_.close(error_code);
-        });
+void HttpSession::close()
+{
+    boost::beast::error_code error_code;
+    socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_send, error_code);
+
+    deadline_.cancel();
 }
\ No newline at end of file
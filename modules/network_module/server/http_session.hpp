@@ -6,14 +6,24 @@
 #include <string>
 #include <list>
 #include <map>
+#include <filesystem>
 
+#include <boost/optional.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/beast/core/flat_buffer.hpp>
 #include <boost/beast/http/dynamic_body.hpp>
+#include <boost/beast/http/string_body.hpp>
+#include <boost/beast/http/span_body.hpp>
+#include <boost/beast/http/empty_body.hpp>
 
 #include "../network_module_common.hpp"
 
 #include "sessions_manager.hpp"
+#include "file_transfer.hpp"
+#include "file_upload.hpp"
+#include "router.hpp"
+#include "session_context.hpp"
+#include "timer_wheel.hpp"
 
 #include "../network_module.hpp"
 
@@ -23,35 +33,69 @@ public:
     HttpSession() = delete;
     HttpSession(boost::asio::ip::tcp::socket socket,
                 SessionsManager &session_manager,
-                boost::asio::io_context &io_context,
-                const network_module::server::Server::Config::Callbacks callbacks);
+                TimerWheel &timer_wheel,
+                SessionContextPtr context);
     ~HttpSession();
 
     void start();
 
 private:
     void read();
+    void on_read_header(boost::beast::error_code error_code,
+                        std::size_t bytes_transferred);
+    void read_body(std::function<void()> read);
     void on_read(boost::beast::error_code error_code,
                  std::size_t bytes_transferred);
+    bool is_read_failed(const boost::beast::error_code &error_code);
 
-    void write();
+    void upload(const std::filesystem::path &file_path);
+    void on_upload(const FileUpload::Status &status,
+                   const FileUpload::Result &result);
+
+    template <class Body>
+    void write(boost::beast::http::response<Body> &response);
     void on_write(boost::beast::error_code error_code,
-                  std::size_t bytes_transferred);
+                  std::size_t bytes_transferred,
+                  bool is_need_eof);
 
     void do_request_responce();
-    void create_response();
-    void check_deadline();
+    void write_handler_result(const boost::beast::http::status &status,
+                              const Router::Handler &handler);
+    void call_async_handler(const Router::Handler &handler);
+    void write_response(const network_module::HttpResponse &response);
+    void write_callback_result(const boost::beast::http::status &status,
+                               const std::string &body);
+    void write_text(const boost::beast::http::status &status,
+                    const std::string &text);
+    void write_content(const boost::beast::http::status &status,
+                       network_module::HttpContentPtr content);
+    bool write_file(const std::filesystem::path &file_path);
+    std::vector<FileTransfer::Part> make_file_parts(boost::beast::http::response<boost::beast::http::empty_body> &response,
+                                                    const std::string &etag,
+                                                    const std::uint64_t &size) const;
+    void write_not_found();
+
+    bool is_keep_alive() const;
+    void on_deadline(const std::uint64_t &generation);
+    void close();
 
 private:
-    const network_module::server::Server::Config::Callbacks kCallbacks_;
+    const SessionContextPtr kContext_;
+
+    network_module::HttpRequest route_request_;
+
+    int requests_number_{0};
 
     boost::asio::ip::tcp::socket socket_;
     boost::beast::flat_buffer buffer_{8192};
-    boost::beast::http::request<boost::beast::http::dynamic_body> request_;
+    boost::optional<boost::beast::http::request_parser<boost::beast::http::empty_body>> header_parser_;
+    boost::optional<boost::beast::http::request_parser<boost::beast::http::string_body>> body_parser_;
+    boost::beast::http::request<boost::beast::http::string_body> request_;
     boost::beast::http::response<boost::beast::http::dynamic_body> response_;
-    boost::asio::steady_timer deadline_;
+    boost::beast::http::response<boost::beast::http::span_body<char const>> content_response_;
+    network_module::HttpContentPtr content_;
+    TimerWheel &timer_wheel_;
+    TimerWheel::Timer deadline_;
 
     SessionsManager &session_manager_;
-
-    boost::asio::io_context &io_context_;
 };
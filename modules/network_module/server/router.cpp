@@ -0,0 +1,299 @@
+#include "router.hpp"
+
+#include <algorithm>
+
+#include "easylogging++.h"
+
+namespace
+{
+    const std::string_view kWildcard("*");
+    const char kParameterPrefix{':'};
+
+    bool find_method(const std::vector<std::pair<boost::beast::http::verb, std::size_t>> &methods,
+                     const boost::beast::http::verb &method,
+                     std::size_t &handler_i)
+    {
+        for (const auto &kMethod : methods)
+        {
+            if (kMethod.first == method)
+            {
+                handler_i = kMethod.second;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool add_method(std::vector<std::pair<boost::beast::http::verb, std::size_t>> &methods,
+                    const boost::beast::http::verb &method,
+                    const std::size_t &handler_i)
+    {
+        std::size_t existing_handler_i = 0;
+        if (find_method(methods, method, existing_handler_i))
+            return false;
+
+        methods.emplace_back(method, handler_i);
+        return true;
+    }
+
+    // Next segment of the path and the rest of the path after it
+    std::string_view pop_segment(std::string_view &path)
+    {
+        while (!path.empty() && path.front() == '/')
+            path.remove_prefix(1);
+
+        const auto kSlash = path.find('/');
+        const auto kSegment = path.substr(0, kSlash);
+
+        path.remove_prefix(kSegment.size());
+        return kSegment;
+    }
+}
+
+Router::Router()
+    : not_found_handler_i_(std::string::npos)
+{
+}
+
+Router::Router(const network_module::server::Server::Config::Callbacks &callbacks)
+    : Router()
+{
+    // Content goes first, it wins over a plain callback of the same url
+    for (const auto &kContentCallback : callbacks.http_content_callbacks_)
+    {
+        if (kContentCallback.second)
+            add(boost::beast::http::verb::get, kContentCallback.first, {{}, kContentCallback.second, {}, {}, false});
+    }
+
+    for (const auto &kCallback : callbacks.http_callbacks_)
+    {
+        if (kCallback.second)
+            add(boost::beast::http::verb::get, kCallback.first, {kCallback.second, {}, {}, {}, false});
+    }
+
+    for (const auto &kRoute : callbacks.http_routes_)
+    {
+        const auto kMethod = boost::beast::http::string_to_verb(kRoute.method_);
+        if (kMethod == boost::beast::http::verb::unknown)
+        {
+            LOG(ERROR) << "Unknown method \"" << kRoute.method_ << "\" of route \"" << kRoute.pattern_ << "\"";
+            continue;
+        }
+
+        if (kRoute.callback_ || kRoute.async_callback_)
+            add(kMethod, kRoute.pattern_, {{}, {}, kRoute.callback_, kRoute.async_callback_, kRoute.is_blocking_});
+    }
+
+    network_module::HttpParameters parameters;
+    std::size_t handler_i = 0;
+    const MethodsTable *path_table = nullptr;
+
+    if (match(root_, network_module::Urls::kPageNotFound_, boost::beast::http::verb::get, parameters, handler_i, path_table))
+        not_found_handler_i_ = handler_i;
+}
+
+bool Router::add(const boost::beast::http::verb &method,
+                 const std::string_view &pattern,
+                 Handler handler)
+{
+    Node *node = &root_;
+    std::string_view path(pattern);
+
+    std::string static_path;
+    bool is_static = true;
+
+    while (true)
+    {
+        const auto kSegment = pop_segment(path);
+        if (kSegment.empty())
+            break;
+
+        if (kSegment == kWildcard)
+        {
+            if (!pop_segment(path).empty())
+            {
+                LOG(ERROR) << "Wildcard must be the last segment of \"" << pattern << "\"";
+                return false;
+            }
+
+            if (!add_method(node->wildcard_methods_, method, handlers_.size()))
+            {
+                LOG(ERROR) << "Route " << boost::beast::http::to_string(method) << " \"" << pattern << "\" already exists";
+                return false;
+            }
+
+            handlers_.push_back(std::move(handler));
+            return true;
+        }
+
+        if (kSegment.front() == kParameterPrefix)
+        {
+            const auto kName = kSegment.substr(1);
+
+            if (!node->parameter_child_)
+            {
+                node->parameter_name_ = kName;
+                node->parameter_child_ = std::make_unique<Node>();
+            }
+            else if (node->parameter_name_ != kName)
+            {
+                LOG(ERROR) << "Parameter \"" << kName << "\" of \"" << pattern
+                           << "\" conflicts with \"" << node->parameter_name_ << "\"";
+                return false;
+            }
+
+            node = node->parameter_child_.get();
+            is_static = false;
+            continue;
+        }
+
+        auto position = std::lower_bound(node->children_.begin(), node->children_.end(), kSegment,
+                                         [](const std::pair<std::string, std::unique_ptr<Node>> &child, const std::string_view &segment)
+                                         { return std::string_view(child.first) < segment; });
+
+        if ((position == node->children_.end()) || (position->first != kSegment))
+            position = node->children_.emplace(position, std::string(kSegment), std::make_unique<Node>());
+
+        node = position->second.get();
+        static_path.append("/").append(kSegment);
+    }
+
+    if (!add_method(node->methods_, method, handlers_.size()))
+    {
+        LOG(ERROR) << "Route " << boost::beast::http::to_string(method) << " \"" << pattern << "\" already exists";
+        return false;
+    }
+
+    handlers_.push_back(std::move(handler));
+
+    if (is_static && node->static_path_.empty())
+    {
+        node->static_path_ = static_path.empty() ? std::string("/") : std::move(static_path);
+        static_nodes_.emplace(node->static_path_, node);
+    }
+
+    return true;
+}
+
+Router::Status Router::find(const boost::beast::http::verb &method,
+                            const std::string_view &path,
+                            network_module::HttpParameters &parameters,
+                            const Handler *&handler) const
+{
+    parameters.clear();
+
+    std::size_t handler_i = 0;
+    const MethodsTable *path_table = nullptr;
+
+    // An exact static route has the highest priority, a path that isn't
+    // normalized or lacks the method goes through the trie
+    const auto kStaticNode = static_nodes_.find(path);
+    if ((kStaticNode != static_nodes_.end()) && find_method(kStaticNode->second->methods_, method, handler_i))
+    {
+        handler = &handlers_[handler_i];
+        return Status::kFound;
+    }
+
+    if (match(root_, path, method, parameters, handler_i, path_table))
+    {
+        handler = &handlers_[handler_i];
+        return Status::kFound;
+    }
+
+    handler = nullptr;
+    return path_table ? Status::kMethodNotAllowed : Status::kNotFound;
+}
+
+std::string Router::get_allowed_methods(const std::string_view &path) const
+{
+    network_module::HttpParameters parameters;
+    std::size_t handler_i = 0;
+    const MethodsTable *path_table = nullptr;
+
+    match(root_, path, boost::beast::http::verb::unknown, parameters, handler_i, path_table);
+
+    std::string allowed_methods;
+    if (!path_table)
+        return allowed_methods;
+
+    for (const auto &kMethod : *path_table)
+    {
+        if (!allowed_methods.empty())
+            allowed_methods += ", ";
+
+        allowed_methods += std::string(boost::beast::http::to_string(kMethod.first));
+    }
+
+    return allowed_methods;
+}
+
+const Router::Handler *Router::get_not_found_handler() const
+{
+    if (not_found_handler_i_ == std::string::npos)
+        return nullptr;
+
+    return &handlers_[not_found_handler_i_];
+}
+
+const Router::MethodsTable *Router::match(const Node &node,
+                                          std::string_view path,
+                                          const boost::beast::http::verb &method,
+                                          network_module::HttpParameters &parameters,
+                                          std::size_t &handler_i,
+                                          const MethodsTable *&path_table) const
+{
+    const auto kRest = path;
+    const auto kSegment = pop_segment(path);
+
+    if (kSegment.empty())
+    {
+        if (find_method(node.methods_, method, handler_i))
+            return &node.methods_;
+
+        if (!node.methods_.empty() && !path_table)
+            path_table = &node.methods_;
+    }
+    else
+    {
+        const auto kPosition = std::lower_bound(node.children_.begin(), node.children_.end(), kSegment,
+                                                [](const std::pair<std::string, std::unique_ptr<Node>> &child, const std::string_view &segment)
+                                                { return std::string_view(child.first) < segment; });
+
+        if ((kPosition != node.children_.end()) && (kPosition->first == kSegment))
+        {
+            const auto kTable = match(*kPosition->second, path, method, parameters, handler_i, path_table);
+            if (kTable)
+                return kTable;
+        }
+
+        if (node.parameter_child_)
+        {
+            parameters.emplace_back(node.parameter_name_, kSegment);
+
+            const auto kTable = match(*node.parameter_child_, path, method, parameters, handler_i, path_table);
+            if (kTable)
+                return kTable;
+
+            parameters.pop_back();
+        }
+    }
+
+    if (!node.wildcard_methods_.empty())
+    {
+        if (find_method(node.wildcard_methods_, method, handler_i))
+        {
+            auto wildcard_value = kRest;
+            while (!wildcard_value.empty() && wildcard_value.front() == '/')
+                wildcard_value.remove_prefix(1);
+
+            parameters.emplace_back(kWildcard, wildcard_value);
+            return &node.wildcard_methods_;
+        }
+
+        if (!path_table)
+            path_table = &node.wildcard_methods_;
+    }
+
+    return nullptr;
+}
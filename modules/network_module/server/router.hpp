@@ -0,0 +1,95 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <string_view>
+#include <unordered_map>
+
+#include <boost/beast/http/verb.hpp>
+
+#include "../network_module.hpp"
+
+// Route table compiled once at server start. Route patterns are split by '/'
+// into a trie of segments, so a lookup walks the request path once and doesn't
+// allocate. Static segments win over ":parameter" segments, parameters win
+// over a trailing "*" wildcard. Fully static routes are also hashed by their
+// path, the common case of an exact url is a single hash lookup
+class Router
+{
+public:
+    struct Handler
+    {
+        network_module::HttpCallback callback_;
+        network_module::HttpContentCallback content_callback_;
+        network_module::HttpRequestCallback request_callback_;
+        network_module::HttpAsyncCallback async_callback_;
+        bool is_blocking_{false};
+    };
+
+    enum class Status
+    {
+        kFound,
+        kMethodNotAllowed,
+        kNotFound
+    };
+
+    Router();
+    // GET routes for http_callbacks_ and http_content_callbacks_ plus http_routes_
+    explicit Router(const network_module::server::Server::Config::Callbacks &callbacks);
+    // static_nodes_ keeps views and pointers into the nodes
+    Router(const Router &) = delete;
+    Router &operator=(const Router &) = delete;
+    ~Router() = default;
+
+    bool add(const boost::beast::http::verb &method,
+             const std::string_view &pattern,
+             Handler handler);
+
+    // Path must not contain the query. Parameters are cleared and filled
+    // with views into the path
+    Status find(const boost::beast::http::verb &method,
+                const std::string_view &path,
+                network_module::HttpParameters &parameters,
+                const Handler *&handler) const;
+
+    // Comma separated methods of the path for the Allow header
+    std::string get_allowed_methods(const std::string_view &path) const;
+
+    // Handler of Urls::kPageNotFound_, nullptr if it isn't registered
+    const Handler *get_not_found_handler() const;
+
+private:
+    typedef std::vector<std::pair<boost::beast::http::verb, std::size_t>> MethodsTable;
+
+    struct Node
+    {
+        std::vector<std::pair<std::string, std::unique_ptr<Node>>> children_; // Sorted by segment
+
+        std::string parameter_name_;
+        std::unique_ptr<Node> parameter_child_;
+
+        MethodsTable methods_;
+        MethodsTable wildcard_methods_;
+
+        std::string static_path_; // Normalized path of a fully static route, the key of static_nodes_
+    };
+
+    // Returns the table of the first matching route having the method.
+    // path_table is the first matching route table whatever its methods are
+    const MethodsTable *match(const Node &node,
+                              std::string_view path,
+                              const boost::beast::http::verb &method,
+                              network_module::HttpParameters &parameters,
+                              std::size_t &handler_i,
+                              const MethodsTable *&path_table) const;
+
+private:
+    Node root_;
+    std::vector<Handler> handlers_;
+
+    std::unordered_map<std::string_view, const Node *> static_nodes_;
+
+    std::size_t not_found_handler_i_;
+};
@@ -1,6 +1,8 @@
 #include "../network_module.hpp"
 
 #include <thread>
+#include <vector>
+#include <memory>
 #include <functional>
 
 #include <boost/bind.hpp>
@@ -13,6 +15,8 @@
 
 #include "http_session.hpp"
 #include "sessions_manager.hpp"
+#include "session_context.hpp"
+#include "timer_wheel.hpp"
 
 namespace
 {
@@ -20,6 +24,52 @@ namespace
     {
         return !(error_code == boost::asio::error::operation_aborted);
     }
+
+#ifdef SO_REUSEPORT
+    typedef boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT> reuse_port;
+#endif
+
+    const std::string kSharedIoMode{"shared"};
+    const std::string kShardedIoMode{"sharded"};
+
+    network_module::server::Server::Config::IoMode parse_io_mode(const std::string &io_mode)
+    {
+        if (io_mode == kSharedIoMode)
+            return network_module::server::Server::Config::IoMode::kShared;
+
+        if (io_mode == kShardedIoMode)
+            return network_module::server::Server::Config::IoMode::kSharded;
+
+        const std::string kErrorText{"Unknown io_mode \"" + io_mode + "\""};
+        LOG(ERROR) << kErrorText;
+        throw std::runtime_error(kErrorText);
+    }
+
+    const std::string kDropOldestPolicy{"drop_oldest"};
+    const std::string kDropNewestPolicy{"drop_newest"};
+    const std::string kCoalescePolicy{"coalesce"};
+    const std::string kDisconnectPolicy{"disconnect"};
+
+    network_module::server::Server::Config::WebSocketSettings::OverflowPolicy parse_overflow_policy(const std::string &policy)
+    {
+        typedef network_module::server::Server::Config::WebSocketSettings::OverflowPolicy OverflowPolicy;
+
+        if (policy == kDropOldestPolicy)
+            return OverflowPolicy::kDropOldest;
+
+        if (policy == kDropNewestPolicy)
+            return OverflowPolicy::kDropNewest;
+
+        if (policy == kCoalescePolicy)
+            return OverflowPolicy::kCoalesce;
+
+        if (policy == kDisconnectPolicy)
+            return OverflowPolicy::kDisconnect;
+
+        const std::string kErrorText{"Unknown send_queue_overflow_policy \"" + policy + "\""};
+        LOG(ERROR) << kErrorText;
+        throw std::runtime_error(kErrorText);
+    }
 }
 
 namespace network_module
@@ -31,6 +81,30 @@ namespace network_module
             nlohmann::json json_object;
             json_object["host"] = "127.0.0.1";
             json_object["port"] = 8080;
+            json_object["io_mode"] = kSharedIoMode;
+            json_object["request_timeout_sec"] = 60;
+            json_object["keep_alive_timeout_sec"] = 5;
+            json_object["write_timeout_sec"] = 60;
+            json_object["max_keep_alive_requests"] = 100;
+            json_object["blocking_threads_number"] = 0;
+            json_object["storage_root"] = "";
+            json_object["storage_url_prefix"] = "/storage/";
+            json_object["max_upload_size_mb"] = 4096;
+            json_object["send_queue_max_messages"] = 1024;
+            json_object["send_queue_max_bytes"] = 16 * 1024 * 1024;
+            json_object["send_queue_overflow_policy"] = kDropOldestPolicy;
+            json_object["send_queue_coalescing"] = false;
+            json_object["send_queue_coalescing_separator"] = "\n";
+            json_object["topics_enabled"] = false;
+            json_object["max_topics_per_session"] = 64;
+            json_object["receiving_threads_number"] = 0;
+            json_object["receiving_queue_max_messages"] = 64;
+            json_object["compression_enabled"] = false;
+            json_object["compression_max_window_bits"] = 15;
+            json_object["compression_memory_level"] = 4;
+            json_object["compression_level"] = 8;
+            json_object["compression_context_takeover"] = true;
+            json_object["ping_interval_sec"] = 30;
 
             std::fstream file(config_path);
             if (!file.is_open())
@@ -62,6 +136,59 @@ namespace network_module
             network_module::server::Server::Config config;
             json_object.at("host").get_to(config.host_);
             json_object.at("port").get_to(config.port_);
+            config.io_mode_ = parse_io_mode(json_object.value("io_mode", kSharedIoMode));
+            config.http_settings_.request_timeout_sec_ =
+                json_object.value("request_timeout_sec", config.http_settings_.request_timeout_sec_);
+            config.http_settings_.keep_alive_timeout_sec_ =
+                json_object.value("keep_alive_timeout_sec", config.http_settings_.keep_alive_timeout_sec_);
+            config.http_settings_.write_timeout_sec_ =
+                json_object.value("write_timeout_sec", config.http_settings_.write_timeout_sec_);
+            config.http_settings_.max_keep_alive_requests_ =
+                json_object.value("max_keep_alive_requests", config.http_settings_.max_keep_alive_requests_);
+            config.http_settings_.blocking_threads_number_ =
+                json_object.value("blocking_threads_number", config.http_settings_.blocking_threads_number_);
+            config.http_settings_.storage_root_path_ =
+                json_object.value("storage_root", config.http_settings_.storage_root_path_);
+            config.http_settings_.storage_url_prefix_ =
+                json_object.value("storage_url_prefix", config.http_settings_.storage_url_prefix_);
+            config.http_settings_.max_upload_size_mb_ =
+                json_object.value("max_upload_size_mb", config.http_settings_.max_upload_size_mb_);
+            config.web_socket_settings_.max_queue_messages_ =
+                json_object.value("send_queue_max_messages", config.web_socket_settings_.max_queue_messages_);
+            config.web_socket_settings_.max_queue_bytes_ =
+                json_object.value("send_queue_max_bytes", config.web_socket_settings_.max_queue_bytes_);
+            config.web_socket_settings_.overflow_policy_ =
+                parse_overflow_policy(json_object.value("send_queue_overflow_policy", kDropOldestPolicy));
+            config.web_socket_settings_.is_write_coalescing_ =
+                json_object.value("send_queue_coalescing", config.web_socket_settings_.is_write_coalescing_);
+            config.web_socket_settings_.coalescing_separator_ =
+                json_object.value("send_queue_coalescing_separator", config.web_socket_settings_.coalescing_separator_);
+            config.web_socket_settings_.is_topics_enabled_ =
+                json_object.value("topics_enabled", config.web_socket_settings_.is_topics_enabled_);
+            config.web_socket_settings_.max_topics_per_session_ =
+                json_object.value("max_topics_per_session", config.web_socket_settings_.max_topics_per_session_);
+            config.web_socket_settings_.receiving_threads_number_ =
+                json_object.value("receiving_threads_number", config.web_socket_settings_.receiving_threads_number_);
+            config.web_socket_settings_.max_receiving_queue_messages_ =
+                json_object.value("receiving_queue_max_messages", config.web_socket_settings_.max_receiving_queue_messages_);
+
+            auto &compression = config.web_socket_settings_.compression_;
+            compression.is_enabled_ = json_object.value("compression_enabled", compression.is_enabled_);
+            compression.max_window_bits_ = json_object.value("compression_max_window_bits", compression.max_window_bits_);
+            compression.memory_level_ = json_object.value("compression_memory_level", compression.memory_level_);
+            compression.level_ = json_object.value("compression_level", compression.level_);
+            compression.is_context_takeover_ = json_object.value("compression_context_takeover", compression.is_context_takeover_);
+
+            // Beast throws for such values only when a session applies them
+            const std::string kCompressionError{compression.get_error()};
+            if (!kCompressionError.empty())
+            {
+                LOG(ERROR) << kCompressionError;
+                throw std::runtime_error(kCompressionError);
+            }
+
+            config.web_socket_settings_.ping_interval_sec_ =
+                json_object.value("ping_interval_sec", config.web_socket_settings_.ping_interval_sec_);
 
             return config;
         }
@@ -82,22 +209,49 @@ namespace network_module
                        const Server::Config &config);
             void stop();
 
-            bool send(const std::string &data);
+            bool send(const std::string &data, const std::string &key);
+            bool send_to(const web_sockets::SessionId &session_id, const std::string &data);
+            std::size_t send_to(const std::vector<web_sockets::SessionId> &sessions_ids, const std::string &data);
+            bool publish(const std::string &topic, const std::string &data);
+
+            Server::Statistics get_statistics() const;
 
         private:
-            void accept(const Server::Config &config);
-            void on_accept(const boost::system::error_code &error, const Server::Config &config);
+            // Event loop with its own acceptor. Sessions accepted by a shard
+            // live on its io_context for their whole life
+            struct Shard
+            {
+                explicit Shard(const int &concurrency_hint);
+
+                // Every session gets its own strand when several threads run the io_context
+                const bool kIsStrandNeeded_;
+
+                // Deadlines of the sessions, destroyed after the io_context
+                // as sessions left in it hold timers of the wheel
+                TimerWheel timer_wheel_;
+
+                boost::asio::io_context io_context_;
+
+                std::unique_ptr<boost::asio::ip::tcp::acceptor> acceptor_;
+                std::unique_ptr<boost::asio::ip::tcp::socket> socket_;
+            };
+
+            bool open_acceptor(Shard &shard,
+                               const boost::asio::ip::tcp::endpoint &endpoint,
+                               const bool &is_port_shared);
+
+            void accept(Shard &shard);
+            void on_accept(const boost::system::error_code &error, Shard &shard);
 
         private:
-            std::unique_ptr<const Config> config_;
+            SessionContextPtr context_;
+            std::unique_ptr<boost::asio::thread_pool> blocking_pool_;
+            std::unique_ptr<boost::asio::thread_pool> receiving_pool_;
 
             std::mutex connecting_mutex_;
             std::condition_variable connecting_watcher_;
 
-            boost::asio::io_context io_context_;
-
-            std::shared_ptr<boost::asio::ip::tcp::acceptor> acceptor_;
-            std::shared_ptr<boost::asio::ip::tcp::socket> socket_;
+            std::vector<std::unique_ptr<Shard>> shards_;
 
             SessionsManager session_manager_;
 
@@ -105,6 +259,12 @@ namespace network_module
             std::mutex mutex_;
         };
 
+        Server::ServerImpl::Shard::Shard(const int &concurrency_hint)
+            : kIsStrandNeeded_(concurrency_hint > 1),
+              io_context_(concurrency_hint)
+        {
+        }
+
         Server::ServerImpl::ServerImpl()
         {
         }
@@ -118,56 +278,80 @@ namespace network_module
 
             stop();
 
+            if (workers_number < 1)
+            {
+                LOG(ERROR) << "Number of available cores in too small";
+                stop();
+                return false;
+            }
+
+            const std::string kCompressionError{config.web_socket_settings_.compression_.get_error()};
+            if (!kCompressionError.empty())
+            {
+                LOG(ERROR) << kCompressionError;
+                return false;
+            }
+
+            bool is_sharded = (config.io_mode_ == Server::Config::IoMode::kSharded);
+#ifndef SO_REUSEPORT
+            if (is_sharded)
+            {
+                LOG(WARNING) << "SO_REUSEPORT is not supported, falling back to shared io_context";
+                is_sharded = false;
+            }
+#endif
+
             boost::asio::ip::tcp::endpoint endpoint(
                 {boost::asio::ip::make_address(config.host_)},
                 config.port_);
 
-            boost::system::error_code error_code;
-
             // Creating
 
-            acceptor_.reset(new boost::asio::ip::tcp::acceptor(io_context_, endpoint));
-            if (!acceptor_)
+            if (config.http_settings_.blocking_threads_number_ > 0)
             {
-                LOG(ERROR) << "Can't create acceptor";
-                stop();
-                return false;
+                LOG(DEBUG) << "Starting " << config.http_settings_.blocking_threads_number_ << " blocking thread(s)...";
+                blocking_pool_ = std::make_unique<boost::asio::thread_pool>(config.http_settings_.blocking_threads_number_);
             }
-            socket_.reset(new boost::asio::ip::tcp::socket(io_context_));
-            if (!socket_)
+
+            if (config.web_socket_settings_.receiving_threads_number_ > 0)
             {
-                LOG(ERROR) << "Can't create socket";
-                stop();
-                return false;
+                LOG(DEBUG) << "Starting " << config.web_socket_settings_.receiving_threads_number_ << " receiving thread(s)...";
+                receiving_pool_ = std::make_unique<boost::asio::thread_pool>(config.web_socket_settings_.receiving_threads_number_);
             }
 
-            // Configuring
+            context_ = std::make_shared<const SessionContext>(config, blocking_pool_.get(), receiving_pool_.get());
 
-            acceptor_->set_option(boost::asio::socket_base::reuse_address(true));
-            if (error_code)
-            {
-                LOG(ERROR) << "Can't set_option - (" << error_code.value() << ") " << error_code.message();
-                stop();
-                return false;
-            }
+            const int kShardsNumber = is_sharded ? workers_number : 1;
+            const int kConcurrencyHint = is_sharded ? 1 : workers_number;
 
-            accept(config);
+            LOG(DEBUG) << "Creating " << kShardsNumber << " io_context(s)...";
 
-            // Starting
+            shards_.reserve(kShardsNumber);
 
-            if (workers_number < 1)
+            for (int shard_i = 0; shard_i < kShardsNumber; ++shard_i)
             {
-                LOG(ERROR) << "Number of available cores in too small";
-                stop();
-                return false;
+                shards_.emplace_back(std::make_unique<Shard>(kConcurrencyHint));
+
+                if (!open_acceptor(*shards_.back(), endpoint, is_sharded))
+                {
+                    stop();
+                    return false;
+                }
+
+                shards_.back()->timer_wheel_.start(shards_.back()->io_context_);
+                accept(*shards_.back());
             }
 
+            // Starting
+
             LOG(DEBUG) << "Starting " << workers_number << " worker-threads...";
 
             workers_.reserve(workers_number);
 
             for (int thread_i = 0; thread_i < workers_number; ++thread_i)
             {
+                auto &io_context = shards_.at(is_sharded ? thread_i : 0)->io_context_;
+
                 workers_.emplace_back(
                     [&]
                     {
@@ -176,7 +360,7 @@ namespace network_module
                             LOG(DEBUG) << "Starting worker [" << std::this_thread::get_id() << "]";
                         }
 
-                        io_context_.run();
+                        io_context.run();
                     });
             }
 
@@ -188,9 +372,8 @@ namespace network_module
         {
             LOG(INFO) << "Stopping...";
 
-            session_manager_.clear();
-
-            io_context_.stop();
+            for (auto &shard : shards_)
+                shard->io_context_.stop();
 
             int worker_i = 0;
             for (auto &worker : workers_)
@@ -201,22 +384,114 @@ namespace network_module
             }
             workers_.clear();
 
-            socket_.reset();
-            acceptor_.reset();
-            io_context_.reset();
+            // Handshakes can add sessions until the workers are joined
+            session_manager_.clear();
+
+            for (auto &shard : shards_)
+                shard->timer_wheel_.stop();
+
+            // Handlers left in the pool are dropped, responders they hold
+            // post to io_contexts which are not run anymore
+            if (blocking_pool_)
+            {
+                blocking_pool_->stop();
+                blocking_pool_->join();
+                blocking_pool_.reset();
+            }
+
+            // Messages not given to the application yet are dropped
+            if (receiving_pool_)
+            {
+                receiving_pool_->stop();
+                receiving_pool_->join();
+                receiving_pool_.reset();
+            }
+
+            shards_.clear();
+            context_.reset();
 
             LOG(INFO) << "Stopped";
         }
 
-        void Server::ServerImpl::accept(const Server::Config &config)
+        bool Server::ServerImpl::open_acceptor(Shard &shard,
+                                               const boost::asio::ip::tcp::endpoint &endpoint,
+                                               const bool &is_port_shared)
+        {
+            boost::system::error_code error_code;
+
+            shard.acceptor_.reset(new boost::asio::ip::tcp::acceptor(shard.io_context_));
+            if (!shard.acceptor_)
+            {
+                LOG(ERROR) << "Can't create acceptor";
+                return false;
+            }
+            shard.socket_.reset(new boost::asio::ip::tcp::socket(shard.io_context_));
+            if (!shard.socket_)
+            {
+                LOG(ERROR) << "Can't create socket";
+                return false;
+            }
+
+            shard.acceptor_->open(endpoint.protocol(), error_code);
+            if (error_code)
+            {
+                LOG(ERROR) << "Can't open acceptor - (" << error_code.value() << ") " << error_code.message();
+                return false;
+            }
+
+            shard.acceptor_->set_option(boost::asio::socket_base::reuse_address(true), error_code);
+            if (error_code)
+            {
+                LOG(ERROR) << "Can't set_option - (" << error_code.value() << ") " << error_code.message();
+                return false;
+            }
+
+#ifdef SO_REUSEPORT
+            if (is_port_shared)
+            {
+                shard.acceptor_->set_option(reuse_port(true), error_code);
+                if (error_code)
+                {
+                    LOG(ERROR) << "Can't set_option - (" << error_code.value() << ") " << error_code.message();
+                    return false;
+                }
+            }
+#endif
+
+            shard.acceptor_->bind(endpoint, error_code);
+            if (error_code)
+            {
+                LOG(ERROR) << "Can't bind - (" << error_code.value() << ") " << error_code.message();
+                return false;
+            }
+
+            shard.acceptor_->listen(boost::asio::socket_base::max_listen_connections, error_code);
+            if (error_code)
+            {
+                LOG(ERROR) << "Can't listen - (" << error_code.value() << ") " << error_code.message();
+                return false;
+            }
+
+            return true;
+        }
+
+        void Server::ServerImpl::accept(Shard &shard)
         {
             LOG(DEBUG);
 
-            acceptor_->async_accept(*socket_, boost::bind(&Server::ServerImpl::on_accept, this,
-                                                          boost::asio::placeholders::error, config));
+            // Operations of the accepted socket and everything created with
+            // its executor are serialized, handlers of one session never run
+            // concurrently and Server::send can post to it from any thread
+            if (shard.kIsStrandNeeded_)
+                shard.socket_.reset(new boost::asio::ip::tcp::socket(boost::asio::make_strand(shard.io_context_)));
+
+            shard.acceptor_->async_accept(*shard.socket_, boost::bind(&Server::ServerImpl::on_accept, this,
+                                                                      boost::asio::placeholders::error,
+                                                                      boost::ref(shard)));
         }
 
-        void Server::ServerImpl::on_accept(const boost::system::error_code &error_code, const Server::Config &config)
+        void Server::ServerImpl::on_accept(const boost::system::error_code &error_code,
+                                           Shard &shard)
         {
             LOG(DEBUG);
 
@@ -224,23 +499,47 @@ namespace network_module
             {
                 if (is_error_important(error_code))
                     LOG(ERROR) << "async_accept - (" << error_code.value() << ") " << error_code.message();
+
+                if (!shard.acceptor_->is_open())
+                    return;
             }
             else
             {
                 LOG(DEBUG) << "Creating new http connection...";
-                auto session = std::make_shared<HttpSession>(std::move(*socket_),
+                auto session = std::make_shared<HttpSession>(std::move(*shard.socket_),
                                                              session_manager_,
-                                                             io_context_,
-                                                             config.callbacks_);
+                                                             shard.timer_wheel_,
+                                                             context_);
                 session->start();
             }
 
-            accept(config);
+            accept(shard);
+        }
+
+        bool Server::ServerImpl::send(const std::string &data, const std::string &key)
+        {
+            return session_manager_.send(data, key);
+        }
+
+        bool Server::ServerImpl::send_to(const web_sockets::SessionId &session_id, const std::string &data)
+        {
+            return session_manager_.send_to(session_id, data);
         }
 
-        bool Server::ServerImpl::send(const std::string &data)
+        std::size_t Server::ServerImpl::send_to(const std::vector<web_sockets::SessionId> &sessions_ids,
+                                                const std::string &data)
         {
-            return session_manager_.send(data);
+            return session_manager_.send_to(sessions_ids, data);
+        }
+
+        bool Server::ServerImpl::publish(const std::string &topic, const std::string &data)
+        {
+            return session_manager_.publish(topic, data);
+        }
+
+        Server::Statistics Server::ServerImpl::get_statistics() const
+        {
+            return session_manager_.get_statistics();
         }
     }
 }
@@ -285,6 +584,22 @@ namespace network_module
         }
 
         bool Server::send(const std::string &data)
+        {
+            return send(data, std::string());
+        }
+
+        bool Server::send(const std::string &data, const std::string &key)
+        {
+            if (!server_impl_)
+            {
+                LOG(ERROR) << "Implementation is not created";
+                return false;
+            }
+
+            return server_impl_->send(data, key);
+        }
+
+        bool Server::send_to(const web_sockets::SessionId &session_id, const std::string &data)
         {
             if (!server_impl_)
             {
@@ -292,7 +607,40 @@ namespace network_module
                 return false;
             }
 
-            return server_impl_->send(data);
+            return server_impl_->send_to(session_id, data);
+        }
+
+        std::size_t Server::send_to(const std::vector<web_sockets::SessionId> &sessions_ids, const std::string &data)
+        {
+            if (!server_impl_)
+            {
+                LOG(ERROR) << "Implementation is not created";
+                return 0;
+            }
+
+            return server_impl_->send_to(sessions_ids, data);
+        }
+
+        bool Server::publish(const std::string &topic, const std::string &data)
+        {
+            if (!server_impl_)
+            {
+                LOG(ERROR) << "Implementation is not created";
+                return false;
+            }
+
+            return server_impl_->publish(topic, data);
+        }
+
+        Server::Statistics Server::get_statistics() const
+        {
+            if (!server_impl_)
+            {
+                LOG(ERROR) << "Implementation is not created";
+                return {};
+            }
+
+            return server_impl_->get_statistics();
         }
     }
 }
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <memory>
+
+#include <boost/asio/thread_pool.hpp>
+
+#include "router.hpp"
+
+#include "../network_module.hpp"
+
+// Part of the server config used by sessions, frozen at Server::start.
+// Sessions share one instance by pointer, so accepting a connection
+// copies neither callbacks nor routes whatever their number is
+struct SessionContext
+{
+    SessionContext(const network_module::server::Server::Config &config,
+                   boost::asio::thread_pool *blocking_pool,
+                   boost::asio::thread_pool *receiving_pool)
+        : http_settings_(config.http_settings_),
+          web_socket_settings_(config.web_socket_settings_),
+          callbacks_(config.callbacks_),
+          router_(config.callbacks_),
+          blocking_pool_(blocking_pool),
+          receiving_pool_(receiving_pool)
+    {
+    }
+
+    const network_module::server::Server::Config::HttpSettings http_settings_;
+    const network_module::server::Server::Config::WebSocketSettings web_socket_settings_;
+    const network_module::server::Server::Config::Callbacks callbacks_;
+    const Router router_;
+
+    boost::asio::thread_pool *const blocking_pool_;  // Owned by the server, nullptr if there is no pool
+    boost::asio::thread_pool *const receiving_pool_; // Owned by the server, nullptr if there is no pool
+};
+typedef std::shared_ptr<const SessionContext> SessionContextPtr;
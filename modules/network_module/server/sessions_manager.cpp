@@ -1,55 +1,267 @@
 #include "sessions_manager.hpp"
 
+#include <algorithm>
+
 #include "easylogging++.h"
 
 #include "websocket_session.hpp"
 #include "http_session.hpp"
 
+network_module::web_sockets::SessionId SessionsManager::make_session_id()
+{
+    return ++last_session_id_;
+}
+
 bool SessionsManager::add(std::shared_ptr<WebSocketSession> session)
 {
-    bool status = false;
+    const auto kSessionId = session->get_id();
+    auto &shard = get_shard(kSessionId);
 
     {
-        std::lock_guard<std::mutex> lock(websocket_mutex_);
-        status = websocket_sessions_.insert(session).second;
+        std::lock_guard<std::mutex> lock(shard.mutex_);
+        if (!shard.sessions_.emplace(kSessionId, std::move(session)).second)
+            return false;
+
+        shard.is_changed_ = true;
     }
 
-    return status;
+    ++sessions_number_;
+    return true;
 }
 
-void SessionsManager::remove(WebSocketSession *session)
+void SessionsManager::remove(const network_module::web_sockets::SessionId &session_id)
 {
-    std::lock_guard<std::mutex> lock(websocket_mutex_);
+    auto &shard = get_shard(session_id);
 
-    for (auto iter = websocket_sessions_.begin(); iter != websocket_sessions_.end(); ++iter)
     {
-        if ((*iter).get() == session)
-        {
-            websocket_sessions_.erase(*iter);
-            break;
-        }
+        std::lock_guard<std::mutex> lock(shard.mutex_);
+        if (shard.sessions_.erase(session_id) == 0)
+            return;
+
+        shard.is_changed_ = true;
     }
+
+    --sessions_number_;
 }
 
-bool SessionsManager::send(const std::string &message)
+bool SessionsManager::send(const std::string &message, const std::string &key)
 {
-    if (websocket_sessions_.empty())
+    if (sessions_number_ == 0)
     {
         LOG(ERROR) << "Connections list is empty";
         return false;
     }
 
-    auto const ss = std::make_shared<std::string const>(std::move(message));
+    const OutgoingMessagePtr kMessage = std::make_shared<const OutgoingMessage>(OutgoingMessage{message, key});
 
-    for (auto iter = websocket_sessions_.begin(); iter != websocket_sessions_.end(); ++iter)
+    for (auto &shard : shards_)
     {
-        (*iter)->send(ss);
+        const auto kSnapshot = get_snapshot(shard);
+        if (!kSnapshot)
+            continue;
+
+        for (const auto &kWeakSession : *kSnapshot)
+        {
+            const auto kSession = kWeakSession.lock();
+            if (kSession)
+                kSession->send(kMessage);
+        }
+    }
+
+    return true;
+}
+
+bool SessionsManager::send_to(const network_module::web_sockets::SessionId &session_id, const std::string &message)
+{
+    const auto kSession = find(session_id);
+    if (!kSession)
+        return false;
+
+    kSession->send(std::make_shared<const OutgoingMessage>(OutgoingMessage{message, std::string()}));
+    return true;
+}
+
+std::size_t SessionsManager::send_to(const std::vector<network_module::web_sockets::SessionId> &sessions_ids,
+                                     const std::string &message)
+{
+    const OutgoingMessagePtr kMessage = std::make_shared<const OutgoingMessage>(OutgoingMessage{message, std::string()});
+
+    std::size_t sessions_number = 0;
+    for (const auto &kSessionId : sessions_ids)
+    {
+        const auto kSession = find(kSessionId);
+        if (!kSession)
+            continue;
+
+        kSession->send(kMessage);
+        ++sessions_number;
+    }
+
+    return sessions_number;
+}
+
+bool SessionsManager::subscribe(const std::string &topic, std::shared_ptr<WebSocketSession> session)
+{
+    const auto kSessionId = session->get_id();
+    auto &shard = get_topics_shard(topic);
+
+    std::lock_guard<std::mutex> lock(shard.mutex_);
+
+    auto &subscribed_topic = shard.topics_[topic];
+    if (!subscribed_topic.subscribers_.emplace(kSessionId, std::move(session)).second)
+        return false;
+
+    subscribed_topic.snapshot_.reset();
+    return true;
+}
+
+void SessionsManager::unsubscribe(const std::string &topic, const network_module::web_sockets::SessionId &session_id)
+{
+    auto &shard = get_topics_shard(topic);
+
+    std::lock_guard<std::mutex> lock(shard.mutex_);
+
+    const auto kTopic = shard.topics_.find(topic);
+    if ((kTopic == shard.topics_.end()) || (kTopic->second.subscribers_.erase(session_id) == 0))
+        return;
+
+    if (kTopic->second.subscribers_.empty())
+        shard.topics_.erase(kTopic);
+    else
+        kTopic->second.snapshot_.reset();
+}
+
+bool SessionsManager::publish(const std::string &topic, const std::string &message)
+{
+    std::shared_ptr<const Snapshot> snapshot;
+
+    {
+        auto &shard = get_topics_shard(topic);
+
+        std::lock_guard<std::mutex> lock(shard.mutex_);
+
+        const auto kTopic = shard.topics_.find(topic);
+        if (kTopic == shard.topics_.end())
+            return false;
+
+        if (!kTopic->second.snapshot_)
+        {
+            auto subscribers = std::make_shared<Snapshot>();
+            subscribers->reserve(kTopic->second.subscribers_.size());
+
+            for (const auto &kSubscriber : kTopic->second.subscribers_)
+                subscribers->push_back(kSubscriber.second);
+
+            kTopic->second.snapshot_ = std::move(subscribers);
+        }
+
+        snapshot = kTopic->second.snapshot_;
     }
 
+    // Sending doesn't hold the lock
+    const OutgoingMessagePtr kMessage = std::make_shared<const OutgoingMessage>(OutgoingMessage{message, std::string()});
+
+    for (const auto &kSession : *snapshot)
+        kSession->send(kMessage);
+
     return true;
 }
 
+void SessionsManager::add_queued(const std::ptrdiff_t &messages_number, const std::ptrdiff_t &bytes_number)
+{
+    queued_messages_ += messages_number;
+    queued_bytes_ += bytes_number;
+}
+
+void SessionsManager::add_dropped(const std::size_t &messages_number)
+{
+    dropped_messages_ += messages_number;
+}
+
+void SessionsManager::add_disconnected()
+{
+    ++disconnected_sessions_;
+}
+
+network_module::server::Server::Statistics SessionsManager::get_statistics() const
+{
+    network_module::server::Server::Statistics statistics;
+    statistics.sessions_number_ = sessions_number_;
+    statistics.queued_messages_ = static_cast<std::size_t>(std::max<std::ptrdiff_t>(queued_messages_, 0));
+    statistics.queued_bytes_ = static_cast<std::size_t>(std::max<std::ptrdiff_t>(queued_bytes_, 0));
+    statistics.dropped_messages_ = dropped_messages_;
+    statistics.disconnected_sessions_ = disconnected_sessions_;
+
+    return statistics;
+}
+
 void SessionsManager::clear()
 {
-    websocket_sessions_.clear();
+    for (auto &shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex_);
+
+        sessions_number_ -= shard.sessions_.size();
+        shard.sessions_.clear();
+
+        shard.is_changed_ = false;
+        std::atomic_store(&shard.snapshot_, std::shared_ptr<const WeakSnapshot>());
+    }
+
+    for (auto &shard : topics_shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex_);
+        shard.topics_.clear();
+    }
+}
+
+SessionsManager::Shard &SessionsManager::get_shard(const network_module::web_sockets::SessionId &session_id)
+{
+    return shards_[session_id % kShardsNumber];
+}
+
+std::shared_ptr<WebSocketSession> SessionsManager::find(const network_module::web_sockets::SessionId &session_id)
+{
+    auto &shard = get_shard(session_id);
+
+    std::lock_guard<std::mutex> lock(shard.mutex_);
+
+    const auto kSession = shard.sessions_.find(session_id);
+    if (kSession == shard.sessions_.end())
+        return nullptr;
+
+    return kSession->second;
+}
+
+SessionsManager::TopicsShard &SessionsManager::get_topics_shard(const std::string &topic)
+{
+    return topics_shards_[std::hash<std::string>{}(topic) % kShardsNumber];
+}
+
+std::shared_ptr<const SessionsManager::WeakSnapshot> SessionsManager::get_snapshot(Shard &shard)
+{
+    if (!shard.is_changed_)
+        return std::atomic_load(&shard.snapshot_);
+
+    std::lock_guard<std::mutex> lock(shard.mutex_);
+
+    // Another broadcast could rebuild it meanwhile
+    if (!shard.is_changed_)
+        return std::atomic_load(&shard.snapshot_);
+
+    shard.is_changed_ = false;
+
+    // An empty shard has no snapshot, broadcast skips it
+    std::shared_ptr<WeakSnapshot> snapshot;
+    if (!shard.sessions_.empty())
+    {
+        snapshot = std::make_shared<WeakSnapshot>();
+        snapshot->reserve(shard.sessions_.size());
+
+        for (const auto &kSession : shard.sessions_)
+            snapshot->push_back(kSession.second);
+    }
+
+    std::atomic_store(&shard.snapshot_, std::shared_ptr<const WeakSnapshot>(snapshot));
+    return snapshot;
 }
@@ -1,27 +1,110 @@
 #pragma once
 
-#include <unordered_set>
+#include <unordered_map>
+#include <vector>
 #include <string>
 #include <memory>
 #include <mutex>
+#include <atomic>
+#include <array>
+
+#include "../network_module.hpp"
 
 class WebSocketSession;
 class HttpSession;
 
+// Message shared by all sessions it is sent to
+struct OutgoingMessage
+{
+    std::string data_;
+    std::string key_; // Messages of the same non-empty key are coalesced by OverflowPolicy::kCoalesce
+};
+typedef std::shared_ptr<const OutgoingMessage> OutgoingMessagePtr;
+
+// Registry of websocket sessions split into shards by session id, so
+// connects and disconnects of different sessions rarely meet on a lock.
+// A connect or disconnect only changes the map of its shard and marks it.
+// A broadcast sends over immutable snapshots of the shards, the first one
+// after changes rebuilds the snapshot of a changed shard once for all of
+// them. Snapshots hold weak references, a removed session is released at
+// once and sessions gone meanwhile are skipped
 class SessionsManager
 {
 public:
     SessionsManager() = default;
     ~SessionsManager() = default;
 
+    network_module::web_sockets::SessionId make_session_id();
+
     bool add(std::shared_ptr<WebSocketSession> session);
-    void remove(WebSocketSession *session);
+    void remove(const network_module::web_sockets::SessionId &session_id);
 
     void clear();
 
-    bool send(const std::string &message);
+    bool send(const std::string &message, const std::string &key);
+
+    // Sessions are found by id in their shards
+    bool send_to(const network_module::web_sockets::SessionId &session_id, const std::string &message);
+    std::size_t send_to(const std::vector<network_module::web_sockets::SessionId> &sessions_ids, const std::string &message);
+
+    // Inverted index of topics, a publish walks only the subscribers of its topic
+    bool subscribe(const std::string &topic, std::shared_ptr<WebSocketSession> session);
+    void unsubscribe(const std::string &topic, const network_module::web_sockets::SessionId &session_id);
+    bool publish(const std::string &topic, const std::string &message);
+
+    // Send queues of sessions report their changes
+    void add_queued(const std::ptrdiff_t &messages_number, const std::ptrdiff_t &bytes_number);
+    void add_dropped(const std::size_t &messages_number);
+    void add_disconnected();
+
+    network_module::server::Server::Statistics get_statistics() const;
+
+private:
+    typedef std::vector<std::shared_ptr<WebSocketSession>> Snapshot;
+    typedef std::vector<std::weak_ptr<WebSocketSession>> WeakSnapshot;
+
+    struct Shard
+    {
+        std::mutex mutex_;
+        std::unordered_map<network_module::web_sockets::SessionId, std::shared_ptr<WebSocketSession>> sessions_;
+        std::atomic<bool> is_changed_{false}; // Set under the lock
+
+        // Accessed with std::atomic_load / std::atomic_store
+        std::shared_ptr<const WeakSnapshot> snapshot_;
+    };
+
+    struct Topic
+    {
+        std::unordered_map<network_module::web_sockets::SessionId, std::shared_ptr<WebSocketSession>> subscribers_;
+        std::shared_ptr<const Snapshot> snapshot_; // Reset by changes, rebuilt by the next publish
+    };
+
+    // Topics are split into shards by name, an empty topic is erased
+    struct TopicsShard
+    {
+        std::mutex mutex_;
+        std::unordered_map<std::string, Topic> topics_;
+    };
+
+    static const std::size_t kShardsNumber{16};
+
+    Shard &get_shard(const network_module::web_sockets::SessionId &session_id);
+    // Rebuilds the snapshot of a changed shard under its lock
+    std::shared_ptr<const WeakSnapshot> get_snapshot(Shard &shard);
+
+    std::shared_ptr<WebSocketSession> find(const network_module::web_sockets::SessionId &session_id);
+
+    TopicsShard &get_topics_shard(const std::string &topic);
 
 private:
-    std::mutex websocket_mutex_;
-    std::unordered_set<std::shared_ptr<WebSocketSession>> websocket_sessions_;
-};
\ No newline at end of file
+    std::array<Shard, kShardsNumber> shards_;
+    std::array<TopicsShard, kShardsNumber> topics_shards_;
+
+    std::atomic<network_module::web_sockets::SessionId> last_session_id_{0};
+    std::atomic<std::size_t> sessions_number_{0};
+
+    std::atomic<std::ptrdiff_t> queued_messages_{0};
+    std::atomic<std::ptrdiff_t> queued_bytes_{0};
+    std::atomic<std::uint64_t> dropped_messages_{0};
+    std::atomic<std::uint64_t> disconnected_sessions_{0};
+};
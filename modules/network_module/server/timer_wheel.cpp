@@ -0,0 +1,144 @@
+#include "timer_wheel.hpp"
+
+#include <algorithm>
+
+#include "easylogging++.h"
+
+TimerWheel::Timer::Timer(TimerWheel &timer_wheel)
+    : timer_wheel_(timer_wheel)
+{
+}
+
+TimerWheel::Timer::~Timer()
+{
+    cancel();
+}
+
+void TimerWheel::Timer::set_handler(Handler handler)
+{
+    std::lock_guard<std::mutex> lock(timer_wheel_.mutex_);
+    handler_ = std::move(handler);
+}
+
+void TimerWheel::Timer::expires_after(const std::chrono::milliseconds &duration)
+{
+    timer_wheel_.schedule(*this, duration);
+}
+
+void TimerWheel::Timer::cancel()
+{
+    std::lock_guard<std::mutex> lock(timer_wheel_.mutex_);
+
+    ++generation_;
+    timer_wheel_.unlink(*this);
+}
+
+bool TimerWheel::Timer::is_expired(const std::uint64_t &generation) const
+{
+    std::lock_guard<std::mutex> lock(timer_wheel_.mutex_);
+    return (generation == generation_) && !is_scheduled_;
+}
+
+TimerWheel::TimerWheel(const std::chrono::milliseconds &tick, const std::size_t &slots_number)
+    : kTick_(std::max(tick, std::chrono::milliseconds(1))),
+      slots_(std::max<std::size_t>(slots_number, 1), nullptr)
+{
+}
+
+void TimerWheel::start(boost::asio::io_context &io_context)
+{
+    ticker_.emplace(io_context);
+    ticker_->expires_after(kTick_);
+    wait();
+}
+
+void TimerWheel::stop()
+{
+    ticker_.reset();
+}
+
+void TimerWheel::schedule(Timer &timer, const std::chrono::milliseconds &duration)
+{
+    // Rounded up, a timer never expires early
+    const std::size_t kTicks = std::max<std::size_t>((duration.count() + kTick_.count() - 1) / kTick_.count(), 1);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    ++timer.generation_;
+    unlink(timer);
+
+    timer.slot_ = (current_slot_ + kTicks) % slots_.size();
+    timer.rounds_ = (kTicks - 1) / slots_.size();
+    timer.is_scheduled_ = true;
+
+    auto &head = slots_[timer.slot_];
+    timer.previous_ = nullptr;
+    timer.next_ = head;
+    if (head)
+        head->previous_ = &timer;
+    head = &timer;
+}
+
+void TimerWheel::unlink(Timer &timer)
+{
+    if (!timer.is_scheduled_)
+        return;
+
+    if (timer.previous_)
+        timer.previous_->next_ = timer.next_;
+    else
+        slots_[timer.slot_] = timer.next_;
+
+    if (timer.next_)
+        timer.next_->previous_ = timer.previous_;
+
+    timer.previous_ = nullptr;
+    timer.next_ = nullptr;
+    timer.is_scheduled_ = false;
+}
+
+void TimerWheel::wait()
+{
+    ticker_->async_wait([this](const boost::system::error_code &error_code)
+                        { on_tick(error_code); });
+}
+
+void TimerWheel::on_tick(const boost::system::error_code &error_code)
+{
+    if (error_code)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        current_slot_ = (current_slot_ + 1) % slots_.size();
+
+        Timer *timer = slots_[current_slot_];
+        while (timer)
+        {
+            Timer *const kNext = timer->next_;
+
+            if (timer->rounds_ > 0)
+            {
+                --timer->rounds_;
+            }
+            else
+            {
+                unlink(*timer);
+                if (timer->handler_)
+                    expired_.emplace_back(timer->handler_, timer->generation_);
+            }
+
+            timer = kNext;
+        }
+    }
+
+    // Handlers can arm and destroy timers, they are called without the lock
+    for (const auto &kExpired : expired_)
+        kExpired.first(kExpired.second);
+    expired_.clear();
+
+    // The next tick is counted from the previous one, late ticks catch up
+    ticker_->expires_at(ticker_->expiry() + kTick_);
+    wait();
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <utility>
+#include <optional>
+#include <functional>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+// Deadlines of the connections of one io_context in a hashed timing wheel.
+// A timer is armed and cancelled in O(1), without allocations and without
+// an entry in the kernel visible timer queue, one steady_timer ticks the
+// whole wheel. Deadlines longer than a revolution wait for their round
+// in their slot, so any duration fits
+class TimerWheel
+{
+public:
+    class Timer
+    {
+    public:
+        // Called on a thread of the wheel with the generation of the timer
+        // which expired. The timer can be armed again meanwhile, the handler
+        // posts to its connection and checks is_expired there
+        typedef std::function<void(const std::uint64_t &)> Handler;
+
+        Timer() = delete;
+        explicit Timer(TimerWheel &timer_wheel);
+        Timer(const Timer &) = delete;
+        Timer &operator=(const Timer &) = delete;
+        ~Timer();
+
+        void set_handler(Handler handler);
+
+        // Rearming cancels the previous deadline
+        void expires_after(const std::chrono::milliseconds &duration);
+        void cancel();
+
+        bool is_expired(const std::uint64_t &generation) const;
+
+    private:
+        friend class TimerWheel;
+
+        TimerWheel &timer_wheel_;
+        Handler handler_;
+
+        // Guarded by the mutex of the wheel
+        Timer *previous_{nullptr};
+        Timer *next_{nullptr};
+        std::size_t slot_{0};
+        std::size_t rounds_{0};
+        bool is_scheduled_{false};
+        std::uint64_t generation_{0}; // Changes with every arming and cancelling
+    };
+
+    explicit TimerWheel(const std::chrono::milliseconds &tick = std::chrono::milliseconds(250),
+                        const std::size_t &slots_number = 256);
+    ~TimerWheel() = default;
+
+    // Ticks on the io_context until stop, timers can outlive the ticking
+    // but not the wheel
+    void start(boost::asio::io_context &io_context);
+    void stop();
+
+private:
+    void schedule(Timer &timer, const std::chrono::milliseconds &duration);
+    void unlink(Timer &timer);
+
+    void wait();
+    void on_tick(const boost::system::error_code &error_code);
+
+private:
+    const std::chrono::milliseconds kTick_;
+
+    mutable std::mutex mutex_;
+    std::vector<Timer *> slots_; // Heads of intrusive lists
+    std::size_t current_slot_{0};
+    std::vector<std::pair<Timer::Handler, std::uint64_t>> expired_; // Reused by ticks
+
+    std::optional<boost::asio::steady_timer> ticker_;
+};
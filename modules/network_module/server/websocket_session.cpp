@@ -4,10 +4,14 @@
 
 #include "boost/asio/buffer.hpp"
 
+#include "json.hpp"
+
 #include <memory>
 
 namespace
 {
+    const std::chrono::seconds kHandshakeTimeout{5};
+
     bool is_error_important(const boost::system::error_code &error_code)
     {
         return !((error_code == boost::asio::error::operation_aborted) ||
@@ -17,26 +21,123 @@ namespace
 
 WebSocketSession::WebSocketSession(boost::asio::ip::tcp::socket socket,
                                    SessionsManager &session_manager,
-                                   boost::asio::io_context &io_context,
-                                   const network_module::server::Server::Config::Callbacks::WebSocketsCallbacks callback)
-    : kCallbacks_(callback),
-      session_manager_(session_manager),
+                                   TimerWheel &timer_wheel,
+                                   SessionContextPtr context)
+    : kContext_(std::move(context)),
+      kId_(session_manager.make_session_id()),
       websocket_(std::move(socket)),
-      io_context_(io_context),
-      acception_deadline_timer_(io_context_, boost::posix_time::seconds(5))
+      queue_(std::max<std::size_t>(kContext_->web_socket_settings_.max_queue_messages_, 1)),
+      session_manager_(session_manager),
+      deadline_(timer_wheel)
 {
+    // Server frames aren't masked, so an unfragmented message goes out as its
+    // frame header and the shared payload in one gather write. With auto
+    // fragmentation beast splits every message bigger than its write buffer
+    // into frames, one write each, for every recipient of a broadcast
+    websocket_.auto_fragment(false);
+
+    const auto &kCompression = kContext_->web_socket_settings_.compression_;
+    if (kCompression.is_enabled_)
+    {
+        boost::beast::websocket::permessage_deflate option;
+        option.server_enable = true;
+        option.server_max_window_bits = kCompression.max_window_bits_;
+        option.client_max_window_bits = kCompression.max_window_bits_;
+        option.server_no_context_takeover = !kCompression.is_context_takeover_;
+        option.client_no_context_takeover = !kCompression.is_context_takeover_;
+        option.memLevel = kCompression.memory_level_;
+        option.compLevel = kCompression.level_;
+        websocket_.set_option(option);
+    }
+
+    // Pongs are handled by the stream, they come here only to prove liveness
+    websocket_.control_callback([this](boost::beast::websocket::frame_type kind, boost::beast::string_view)
+                                {
+                                    if (kind == boost::beast::websocket::frame_type::pong)
+                                    {
+                                        is_peer_active_ = true;
+                                        is_ping_answer_waited_ = false;
+                                    } });
 }
 
 WebSocketSession::~WebSocketSession()
 {
     LOG(DEBUG);
+    session_manager_.add_queued(-static_cast<std::ptrdiff_t>(queue_.size()), -static_cast<std::ptrdiff_t>(queued_bytes_));
 }
 
-void WebSocketSession::on_acception_timer(boost::system::error_code error_code)
+void WebSocketSession::start_deadline()
 {
-    LOG(DEBUG);
-    acception_deadline_timer_.cancel();
-    itself_.reset();
+    // The wheel doesn't keep the session alive
+    deadline_.set_handler([weak_self = weak_from_this()](const std::uint64_t &generation)
+                          {
+                              const auto kSelf = weak_self.lock();
+                              if (!kSelf)
+                                  return;
+
+                              boost::asio::post(kSelf->websocket_.get_executor(),
+                                                [kSelf, generation]()
+                                                {
+                                                    kSelf->on_deadline(generation);
+                                                }); });
+
+    deadline_.expires_after(kHandshakeTimeout);
+}
+
+void WebSocketSession::on_deadline(const std::uint64_t &generation)
+{
+    // Armed again or cancelled after the wheel fired it
+    if (!deadline_.is_expired(generation))
+        return;
+
+    if (is_accepted_)
+    {
+        check_liveness();
+        return;
+    }
+
+    // The pending handshake fails and releases the session
+    LOG(DEBUG) << "Handshake of session " << kId_ << " timed out";
+
+    boost::system::error_code error_code;
+    websocket_.next_layer().close(error_code);
+}
+
+void WebSocketSession::check_liveness()
+{
+    const auto kInterval = std::chrono::seconds(kContext_->web_socket_settings_.ping_interval_sec_);
+
+    if (is_peer_active_)
+    {
+        is_peer_active_ = false;
+        deadline_.expires_after(kInterval);
+        return;
+    }
+
+    // Reads fail after closing and the session stops
+    if (is_ping_answer_waited_)
+    {
+        LOG(DEBUG) << "Session " << kId_ << " doesn't answer, closing";
+
+        boost::system::error_code error_code;
+        websocket_.next_layer().close(error_code);
+        return;
+    }
+
+    is_ping_answer_waited_ = true;
+
+    // A ping stuck behind a slow write isn't doubled
+    if (!is_ping_pending_)
+    {
+        is_ping_pending_ = true;
+        websocket_.async_ping({},
+                              [self = shared_from_this()](boost::system::error_code)
+                              {
+                                  self->is_ping_pending_ = false;
+                              });
+    }
+
+    deadline_.expires_after(kInterval);
 }
 
 void WebSocketSession::do_accept(boost::system::error_code error_code)
@@ -44,39 +145,45 @@ void WebSocketSession::do_accept(boost::system::error_code error_code)
     if (error_code)
     {
         if (is_error_important(error_code))
-        {
             LOG(ERROR) << "accept - (" << error_code.value() << ") " << error_code.message();
-            return;
-        }
+
+        deadline_.cancel();
+        return;
     }
 
-    acception_deadline_timer_.cancel();
+    is_accepted_ = true;
 
-    if (!session_manager_.add(itself_))
+    if (kContext_->web_socket_settings_.ping_interval_sec_ > 0)
+        deadline_.expires_after(std::chrono::seconds(kContext_->web_socket_settings_.ping_interval_sec_));
+    else
+        deadline_.cancel();
+
+    if (!session_manager_.add(shared_from_this()))
     {
         LOG(ERROR) << "Can't add websocket session";
         return;
     }
-    itself_.reset();
 
     prepare_for_reading();
 
-    kCallbacks_.process_new_connection_();
+    kContext_->callbacks_.web_sockets_callbacks_.process_new_connection_(kId_);
 }
 
 void WebSocketSession::prepare_for_reading()
 {
+    // The pending read keeps the session alive, it can be removed
+    // from the manager and its topics by any thread meanwhile
     websocket_.async_read(
         buffer_,
-        boost::bind(
-            &WebSocketSession::on_read,
-            this,
-            boost::asio::placeholders::error,
-            boost::asio::placeholders::bytes_transferred));
+        [self = shared_from_this()](
+            boost::system::error_code error_code, std::size_t bytes_transferred)
+        {
+            self->on_read(error_code, bytes_transferred);
+        });
 }
 
 void WebSocketSession::on_read(boost::system::error_code error_code,
-                               std::size_t bytes_transferred)
+                               std::size_t)
 {
     if (error_code)
     {
@@ -85,24 +192,269 @@ void WebSocketSession::on_read(boost::system::error_code error_code,
         return;
     }
 
-    const std::string kDataString(boost::asio::buffer_cast<const char *>(buffer_.data()), buffer_.size());
+    is_peer_active_ = true;
+    is_ping_answer_waited_ = false;
 
-    kCallbacks_.process_receiving_(kDataString);
+    // Flat buffer holds the message contiguously, the callback gets a view of it
+    const std::string_view kData(static_cast<const char *>(buffer_.data().data()), buffer_.size());
+    const bool kIsBinary = websocket_.got_binary();
+
+    bool is_reading_paused = false;
+
+    if (kIsBinary || !process_subscription(kData))
+    {
+        if (kContext_->receiving_pool_)
+            is_reading_paused = dispatch_receiving(kData, kIsBinary);
+        else
+            kContext_->callbacks_.web_sockets_callbacks_.process_receiving_(kId_, kData, kIsBinary);
+    }
 
     buffer_.consume(buffer_.size()); // Clear buffer
 
-    prepare_for_reading();
+    // The worker which takes the pool below the limit resumes reading
+    if (!is_reading_paused)
+        prepare_for_reading();
+}
+
+bool WebSocketSession::dispatch_receiving(const std::string_view &data, const bool &is_binary)
+{
+    const auto kMaxMessages = std::max<std::size_t>(kContext_->web_socket_settings_.max_receiving_queue_messages_, 1);
+
+    // Counted before queueing, the pool can't take it below zero
+    const bool kIsFull = (++receiving_messages_ >= kMaxMessages);
+
+    std::lock_guard<std::mutex> lock(receiving_mutex_);
+
+    // The buffer is reused by the next read, the pool gets a copy
+    receiving_queue_.emplace_back(std::string(data), is_binary);
+
+    if (!is_receiving_scheduled_)
+    {
+        is_receiving_scheduled_ = true;
+        boost::asio::post(*kContext_->receiving_pool_,
+                          [self = shared_from_this()]()
+                          {
+                              self->process_receiving_queue();
+                          });
+    }
+
+    return kIsFull;
+}
+
+void WebSocketSession::process_receiving_queue()
+{
+    const auto kMaxMessages = std::max<std::size_t>(kContext_->web_socket_settings_.max_receiving_queue_messages_, 1);
+
+    std::deque<std::pair<std::string, bool>> messages;
+    {
+        std::lock_guard<std::mutex> lock(receiving_mutex_);
+        messages.swap(receiving_queue_);
+    }
+
+    for (const auto &kMessage : messages)
+    {
+        kContext_->callbacks_.web_sockets_callbacks_.process_receiving_(kId_, kMessage.first, kMessage.second);
+
+        // Only the read which filled the queue up is paused
+        if (receiving_messages_.fetch_sub(1) == kMaxMessages)
+        {
+            boost::asio::post(websocket_.get_executor(),
+                              [self = shared_from_this()]()
+                              {
+                                  self->prepare_for_reading();
+                              });
+        }
+    }
+
+    // Messages which came meanwhile go in the next task, other sessions aren't starved
+    std::lock_guard<std::mutex> lock(receiving_mutex_);
+
+    if (receiving_queue_.empty())
+    {
+        is_receiving_scheduled_ = false;
+        return;
+    }
+
+    boost::asio::post(*kContext_->receiving_pool_,
+                      [self = shared_from_this()]()
+                      {
+                          self->process_receiving_queue();
+                      });
+}
+
+bool WebSocketSession::process_subscription(const std::string_view &data)
+{
+    const auto &kSettings = kContext_->web_socket_settings_;
+
+    // Most messages aren't json objects and aren't parsed
+    if (!kSettings.is_topics_enabled_ || data.empty() || (data.front() != '{'))
+        return false;
+
+    const auto kJson = nlohmann::json::parse(data.begin(), data.end(), nullptr, false);
+    if (!kJson.is_object() || (kJson.size() != 1))
+        return false;
+
+    const auto kSubscribe = kJson.find("subscribe");
+    if ((kSubscribe != kJson.end()) && kSubscribe->is_string())
+    {
+        const auto kTopic = kSubscribe->get<std::string>();
+        if (topics_.count(kTopic) != 0)
+            return true;
+
+        if (topics_.size() >= kSettings.max_topics_per_session_)
+        {
+            LOG(WARNING) << "Session " << kId_ << " can't subscribe to \"" << kTopic << "\", "
+                         << topics_.size() << " topic(s) are subscribed already";
+            return true;
+        }
+
+        if (session_manager_.subscribe(kTopic, shared_from_this()))
+            topics_.insert(kTopic);
+
+        return true;
+    }
+
+    const auto kUnsubscribe = kJson.find("unsubscribe");
+    if ((kUnsubscribe != kJson.end()) && kUnsubscribe->is_string())
+    {
+        const auto kTopic = kUnsubscribe->get<std::string>();
+        if (topics_.erase(kTopic) != 0)
+            session_manager_.unsubscribe(kTopic, kId_);
+
+        return true;
+    }
+
+    return false;
 }
 
-void WebSocketSession::send(std::shared_ptr<std::string const> const &data)
+void WebSocketSession::send(const OutgoingMessagePtr &message)
 {
-    queue_.push_back(data);
+    // The queue is touched only by handlers of the session
+    boost::asio::post(websocket_.get_executor(),
+                      [self = shared_from_this(), message]()
+                      {
+                          self->enqueue(message);
+                      });
+}
 
-    if (queue_.size() > 1)
+void WebSocketSession::enqueue(const OutgoingMessagePtr &message)
+{
+    if (is_disconnected_)
         return;
 
+    const auto &kSettings = kContext_->web_socket_settings_;
+
+    // The latest state of a key replaces the queued one in place
+    if ((kSettings.overflow_policy_ == network_module::server::Server::Config::WebSocketSettings::OverflowPolicy::kCoalesce) &&
+        !message->key_.empty())
+    {
+        for (auto &queued_message : queue_)
+        {
+            if (queued_message->key_ != message->key_)
+                continue;
+
+            const auto kBytesDifference = static_cast<std::ptrdiff_t>(message->data_.size()) -
+                                          static_cast<std::ptrdiff_t>(queued_message->data_.size());
+
+            queued_bytes_ += kBytesDifference;
+            session_manager_.add_queued(0, kBytesDifference);
+            session_manager_.add_dropped(1);
+
+            queued_message = message;
+            return;
+        }
+    }
+
+    if (!make_room(message))
+        return;
+
+    queue_.push_back(message);
+    queued_bytes_ += message->data_.size();
+    session_manager_.add_queued(1, message->data_.size());
+
+    if (writing_messages_.empty())
+        write();
+}
+
+bool WebSocketSession::make_room(const OutgoingMessagePtr &message)
+{
+    typedef network_module::server::Server::Config::WebSocketSettings::OverflowPolicy OverflowPolicy;
+
+    const auto &kSettings = kContext_->web_socket_settings_;
+
+    // A message bigger than the bytes limit still goes alone
+    while (!queue_.empty() &&
+           (queue_.full() || (queued_bytes_ + message->data_.size() > kSettings.max_queue_bytes_)))
+    {
+        switch (kSettings.overflow_policy_)
+        {
+
+        case OverflowPolicy::kDropNewest:
+        {
+            session_manager_.add_dropped(1);
+            return false;
+        }
+        case OverflowPolicy::kDisconnect:
+        {
+            LOG(WARNING) << "Session " << kId_ << " is too slow, " << queue_.size() << " message(s) of "
+                         << queued_bytes_ << " bytes are waiting, disconnecting";
+
+            is_disconnected_ = true;
+            session_manager_.add_disconnected();
+            session_manager_.add_dropped(queue_.size() + 1);
+            session_manager_.add_queued(-static_cast<std::ptrdiff_t>(queue_.size()), -static_cast<std::ptrdiff_t>(queued_bytes_));
+
+            queue_.clear();
+            queued_bytes_ = 0;
+
+            // Pending reads and writes fail and the session stops
+            boost::system::error_code error_code;
+            websocket_.next_layer().close(error_code);
+            return false;
+        }
+        default:
+        {
+            const auto kOldestSize = queue_.front()->data_.size();
+
+            queue_.pop_front();
+            queued_bytes_ -= kOldestSize;
+            session_manager_.add_queued(-1, -static_cast<std::ptrdiff_t>(kOldestSize));
+            session_manager_.add_dropped(1);
+            break;
+        }
+        }
+    }
+
+    return true;
+}
+
+void WebSocketSession::write()
+{
+    const auto &kSettings = kContext_->web_socket_settings_;
+    const std::size_t kMessagesNumber = kSettings.is_write_coalescing_ ? queue_.size() : 1;
+
+    writing_buffers_.clear();
+    std::size_t bytes_number = 0;
+
+    for (std::size_t message_i = 0; message_i < kMessagesNumber; ++message_i)
+    {
+        writing_messages_.push_back(std::move(queue_.front()));
+        queue_.pop_front();
+
+        const auto &kData = writing_messages_.back()->data_;
+        bytes_number += kData.size();
+
+        if (!writing_buffers_.empty() && !kSettings.coalescing_separator_.empty())
+            writing_buffers_.push_back(boost::asio::buffer(kSettings.coalescing_separator_));
+
+        writing_buffers_.push_back(boost::asio::buffer(kData));
+    }
+
+    queued_bytes_ -= bytes_number;
+    session_manager_.add_queued(-static_cast<std::ptrdiff_t>(kMessagesNumber), -static_cast<std::ptrdiff_t>(bytes_number));
+
     websocket_.async_write(
-        boost::asio::buffer(*queue_.front()),
+        writing_buffers_,
         [self = shared_from_this()](
             boost::system::error_code error_code, std::size_t bytes_transferred)
         {
@@ -111,8 +463,10 @@ void WebSocketSession::send(std::shared_ptr<std::string const> const &data)
 }
 
 void WebSocketSession::do_write(boost::system::error_code error_code,
-                                std::size_t bytes_transferred)
+                                std::size_t)
 {
+    writing_messages_.clear();
+
     if (error_code)
     {
         if (is_error_important(error_code))
@@ -122,21 +476,23 @@ void WebSocketSession::do_write(boost::system::error_code error_code,
         }
     }
 
-    queue_.erase(queue_.begin());
+    if (!queue_.empty() && !is_disconnected_)
+        write();
+}
 
-    if (!queue_.empty())
-        websocket_.async_write(
-            boost::asio::buffer(*queue_.front()),
-            [self = shared_from_this()](
-                boost::system::error_code error_code,
-                std::size_t bytes_transferred)
-            {
-                self->do_write(error_code, bytes_transferred);
-            });
+const network_module::web_sockets::SessionId &WebSocketSession::get_id() const
+{
+    return kId_;
 }
 
 void WebSocketSession::stop()
 {
     LOG(DEBUG);
-    session_manager_.remove(this);
+
+    // Topics hold the session too
+    for (const auto &kTopic : topics_)
+        session_manager_.unsubscribe(kTopic, kId_);
+    topics_.clear();
+
+    session_manager_.remove(kId_);
 }
\ No newline at end of file
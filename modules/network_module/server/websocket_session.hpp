@@ -3,6 +3,13 @@
 #include <vector>
 #include <memory>
 #include <functional>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <utility>
+#include <string>
+#include <string_view>
+#include <unordered_set>
 
 #include "boost/asio/ip/tcp.hpp"
 #include "boost/beast/websocket/stream.hpp"
@@ -12,8 +19,11 @@
 #include "boost/bind.hpp"
 #include "boost/asio/placeholders.hpp"
 #include "boost/asio.hpp"
+#include "boost/circular_buffer.hpp"
 
 #include "sessions_manager.hpp"
+#include "session_context.hpp"
+#include "timer_wheel.hpp"
 
 #include "../network_module.hpp"
 
@@ -25,56 +35,83 @@ public:
     WebSocketSession() = delete;
     WebSocketSession(boost::asio::ip::tcp::socket socket,
                      SessionsManager &session_manager,
-                     boost::asio::io_context &io_context,
-                     const network_module::server::Server::Config::Callbacks::WebSocketsCallbacks callback);
+                     TimerWheel &timer_wheel,
+                     SessionContextPtr context);
     ~WebSocketSession();
 
     template <class Body, class Allocator>
-    void start(boost::beast::http::request<Body, boost::beast::http::basic_fields<Allocator>> request,
-               std::shared_ptr<WebSocketSession> itself);
+    void start(boost::beast::http::request<Body, boost::beast::http::basic_fields<Allocator>> request);
 
-    void send(std::shared_ptr<std::string const> const &data);
+    // Can be called from any thread, the message is queued on the executor of
+    // the session. It is queued when another one is being written,
+    // a full queue is handled by WebSocketSettings::overflow_policy_
+    void send(const OutgoingMessagePtr &message);
+
+    const network_module::web_sockets::SessionId &get_id() const;
 
 private:
     void do_accept(boost::system::error_code error_code);
     void prepare_for_reading();
     void on_read(boost::system::error_code error_code, std::size_t bytes_transferred);
+    // Returns true for subscribe / unsubscribe messages, they aren't passed to the application
+    bool process_subscription(const std::string_view &data);
+    // Returns true when the receiving queue is full and reading has to pause
+    bool dispatch_receiving(const std::string_view &data, const bool &is_binary);
+    void process_receiving_queue();
+    void enqueue(const OutgoingMessagePtr &message);
+    bool make_room(const OutgoingMessagePtr &message);
+    void write();
     void do_write(boost::system::error_code error_code, std::size_t bytes_transferred);
 
-    void on_acception_timer(boost::system::error_code error_code);
+    // One timer limits the handshake, then checks liveness of the peer
+    void start_deadline();
+    void on_deadline(const std::uint64_t &generation);
+    void check_liveness();
 
     void stop();
 
 private:
-    const network_module::server::Server::Config::Callbacks::WebSocketsCallbacks kCallbacks_;
+    const SessionContextPtr kContext_;
+    const network_module::web_sockets::SessionId kId_;
 
     boost::beast::websocket::stream<boost::asio::ip::tcp::socket> websocket_;
     boost::beast::flat_buffer buffer_;
-    std::vector<std::shared_ptr<std::string const>> queue_;
+    boost::circular_buffer<OutgoingMessagePtr> queue_; // Capacity is WebSocketSettings::max_queue_messages_
+    std::size_t queued_bytes_{0};
+    std::vector<OutgoingMessagePtr> writing_messages_; // Out of the queue, dropping can't touch them
+    std::vector<boost::asio::const_buffer> writing_buffers_;
+    bool is_disconnected_{false};
+
+    std::unordered_set<std::string> topics_;
+
+    // Messages waiting for the receiving pool. One pool task at a time drains
+    // them, so they are processed in order. The session doesn't use a strand
+    // of the pool, it can outlive the pool when the server stops
+    std::mutex receiving_mutex_;
+    std::deque<std::pair<std::string, bool>> receiving_queue_; // Data and is_binary
+    bool is_receiving_scheduled_{false};
+    std::atomic<std::size_t> receiving_messages_{0}; // Given to the pool and not processed yet
 
     SessionsManager &session_manager_;
 
-    boost::asio::io_context &io_context_;
-    boost::asio::deadline_timer acception_deadline_timer_;
-
-    std::shared_ptr<WebSocketSession> itself_;
+    TimerWheel::Timer deadline_;
+    bool is_accepted_{false};
+    bool is_peer_active_{true};        // Something came since the last check
+    bool is_ping_answer_waited_{false}; // Peer was pinged after an idle interval
+    bool is_ping_pending_{false};
 };
 
 template <class Body, class Allocator>
-void WebSocketSession::start(boost::beast::http::request<Body, boost::beast::http::basic_fields<Allocator>> request,
-                             std::shared_ptr<WebSocketSession> itself)
+void WebSocketSession::start(boost::beast::http::request<Body, boost::beast::http::basic_fields<Allocator>> request)
 {
-    itself_ = itself;
-
+    // The pending handshake keeps the session alive, it is released with
+    // the handler when the io_context is destroyed before the handshake ends
     websocket_.async_accept(
         request,
         boost::bind(
             &WebSocketSession::do_accept,
-            this,
+            shared_from_this(),
             boost::asio::placeholders::error));
 
-    acception_deadline_timer_.async_wait(
-        boost::bind(&WebSocketSession::on_acception_timer,
-                    this,
-                    boost::asio::placeholders::error));
+    start_deadline();
 }
\ No newline at end of file
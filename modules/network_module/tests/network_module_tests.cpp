@@ -1,13 +1,65 @@
 #include <gtest/gtest.h>
 
 #include <thread>
+#include <atomic>
+#include <map>
+#include <set>
+#include <mutex>
+#include <future>
+#include <fstream>
+#include <filesystem>
+#include <random>
+#include <limits>
+#include <algorithm>
+
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/websocket.hpp>
 
 #include "../configs/cmake_config.h"
 #include "../network_module.hpp"
+#include "../server/http_ranges.hpp"
+#include "../server/router.hpp"
+#include "../server/timer_wheel.hpp"
+#include "../server/sessions_manager.hpp"
+#include "../server/session_context.hpp"
+#include "../server/websocket_session.hpp"
+#include "../../../apps/server/server_console_app/dummy_server/pages_manager/pages_manager.hpp"
+#include "../../../apps/client/client_console_app/load_generator/hdr_histogram.hpp"
 
 #include "easylogging++.h"
 INITIALIZE_EASYLOGGINGPP
 
+namespace
+{
+    // Reads a response in portions with pauses, as a client on a slow link does.
+    // Returns false when the connection is lost before the response is read
+    template <class Body>
+    bool read_slowly(boost::asio::ip::tcp::socket &socket,
+                     boost::beast::flat_buffer &buffer,
+                     boost::beast::http::response_parser<Body> &parser)
+    {
+        // boost::none disables the limit only for chunked bodies in beast 1.74
+        parser.body_limit(std::numeric_limits<std::uint64_t>::max());
+
+        // Every read takes up to the free space of the buffer
+        buffer.reserve(64 * 1024);
+
+        while (!parser.is_done())
+        {
+            boost::system::error_code error_code;
+            boost::beast::http::read_some(socket, buffer, parser, error_code);
+            if (error_code)
+                return false;
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        return true;
+    }
+}
+
 class ServerTests : public ::testing::Test
 {
 public:
@@ -31,4 +83,1857 @@ TEST_F(ServerTests, ConfigLoading)
 
     EXPECT_EQ(kLoadedConfig.host_, "123.456.789.0");
     EXPECT_EQ(kLoadedConfig.port_, 1234);
+    EXPECT_EQ(kLoadedConfig.io_mode_, network_module::server::Server::Config::IoMode::kShared);
+}
+
+TEST_F(ServerTests, ShardedStart)
+{
+    network_module::server::Server::Config config;
+    config.port_ = 18080;
+    config.io_mode_ = network_module::server::Server::Config::IoMode::kSharded;
+
+    network_module::server::Server server;
+    ASSERT_TRUE(server.start(2, config));
+
+    boost::asio::io_context io_context;
+    boost::asio::ip::tcp::socket socket(io_context);
+    boost::system::error_code error_code;
+    socket.connect({boost::asio::ip::make_address(config.host_), static_cast<unsigned short>(config.port_)}, error_code);
+    EXPECT_FALSE(error_code);
+
+    server.stop();
+}
+
+TEST_F(ServerTests, KeepAlivePipelining)
+{
+    network_module::server::Server::Config config;
+    config.port_ = 18096;
+    config.http_settings_.max_keep_alive_requests_ = 3;
+    config.callbacks_.http_callbacks_["/first"] = []()
+    { return "first"; };
+    config.callbacks_.http_callbacks_["/second"] = []()
+    { return "second"; };
+
+    network_module::server::Server server;
+    ASSERT_TRUE(server.start(1, config));
+
+    boost::asio::io_context io_context;
+    boost::asio::ip::tcp::socket socket(io_context);
+    socket.connect({boost::asio::ip::make_address(config.host_), static_cast<unsigned short>(config.port_)});
+
+    // Two requests in one write, answered in order on the same connection
+    const std::string kPipelinedRequests{"GET /first HTTP/1.1\r\nHost: localhost\r\n\r\n"
+                                         "GET /second HTTP/1.1\r\nHost: localhost\r\n\r\n"};
+    boost::asio::write(socket, boost::asio::buffer(kPipelinedRequests));
+
+    boost::beast::flat_buffer buffer;
+    boost::beast::http::response<boost::beast::http::string_body> response;
+
+    boost::beast::http::read(socket, buffer, response);
+    EXPECT_EQ(response.result_int(), 200);
+    EXPECT_EQ(response.body(), "first");
+    EXPECT_TRUE(response.keep_alive());
+
+    response = {};
+    boost::beast::http::read(socket, buffer, response);
+    EXPECT_EQ(response.result_int(), 200);
+    EXPECT_EQ(response.body(), "second");
+    EXPECT_TRUE(response.keep_alive());
+
+    // The last request allowed on the connection is answered with Connection: close
+    boost::asio::write(socket, boost::asio::buffer(std::string{"GET /first HTTP/1.1\r\nHost: localhost\r\n\r\n"}));
+
+    response = {};
+    boost::beast::http::read(socket, buffer, response);
+    EXPECT_EQ(response.body(), "first");
+    EXPECT_FALSE(response.keep_alive());
+    EXPECT_EQ(response[boost::beast::http::field::connection], "close");
+
+    // Then the server closes the connection
+    boost::system::error_code error_code;
+    response = {};
+    boost::beast::http::read(socket, buffer, response, error_code);
+    EXPECT_EQ(error_code, boost::beast::http::error::end_of_stream);
+
+    server.stop();
+}
+
+TEST_F(ServerTests, KeepAliveSlowResponse)
+{
+    const std::string kBody(16 * 1024 * 1024, 'x');
+
+    network_module::server::Server::Config config;
+    config.port_ = 18099;
+    config.http_settings_.request_timeout_sec_ = 1;
+    config.http_settings_.keep_alive_timeout_sec_ = 1;
+    config.callbacks_.http_callbacks_["/small"] = []()
+    { return "small"; };
+    config.callbacks_.http_callbacks_["/big"] = [&kBody]()
+    { return kBody; };
+
+    network_module::server::Server server;
+    ASSERT_TRUE(server.start(1, config));
+
+    boost::asio::io_context io_context;
+    boost::asio::ip::tcp::socket socket(io_context);
+    socket.connect({boost::asio::ip::make_address(config.host_), static_cast<unsigned short>(config.port_)});
+
+    boost::beast::flat_buffer buffer;
+    boost::beast::http::response<boost::beast::http::string_body> response;
+
+    boost::asio::write(socket, boost::asio::buffer(std::string{"GET /small HTTP/1.1\r\nHost: localhost\r\n\r\n"}));
+    boost::beast::http::read(socket, buffer, response);
+    EXPECT_EQ(response.body(), "small");
+
+    // Reading the second response takes longer than both timeouts of waiting for a request
+    boost::asio::write(socket, boost::asio::buffer(std::string{"GET /big HTTP/1.1\r\nHost: localhost\r\n\r\n"}));
+
+    const auto kBegin = std::chrono::steady_clock::now();
+    boost::beast::http::response_parser<boost::beast::http::string_body> parser;
+    ASSERT_TRUE(read_slowly(socket, buffer, parser));
+    EXPECT_GT(std::chrono::steady_clock::now() - kBegin, std::chrono::milliseconds(1500));
+
+    EXPECT_EQ(parser.get().result(), boost::beast::http::status::ok);
+    EXPECT_TRUE(parser.get().body() == kBody);
+
+    // Waiting for the next request is limited again
+    boost::system::error_code error_code;
+    response = {};
+    boost::beast::http::read(socket, buffer, response, error_code);
+    EXPECT_TRUE(error_code);
+
+    server.stop();
+}
+
+TEST_F(ServerTests, PagesCache)
+{
+    const auto kPagesPath = std::filesystem::temp_directory_path() / "network_module_tests_pages";
+    std::filesystem::remove_all(kPagesPath);
+    std::filesystem::create_directories(kPagesPath / "home");
+    std::ofstream(kPagesPath / "home" / "index.html") << "first";
+
+    dummy::server::PagesManager pages_manager(kPagesPath.string(), std::chrono::milliseconds(50));
+
+    network_module::server::Server::Config config;
+    config.port_ = 18100;
+    config.callbacks_.http_content_callbacks_["/"] = [&pages_manager]()
+    { return pages_manager.getHomePage(); };
+
+    network_module::server::Server server;
+    ASSERT_TRUE(server.start(1, config));
+
+    boost::asio::io_context io_context;
+    boost::asio::ip::tcp::socket socket(io_context);
+    socket.connect({boost::asio::ip::make_address(config.host_), static_cast<unsigned short>(config.port_)});
+
+    boost::beast::flat_buffer buffer;
+
+    const auto kGet = [&](const std::string &if_none_match)
+    {
+        boost::beast::http::request<boost::beast::http::empty_body> request{boost::beast::http::verb::get, "/", 11};
+        if (!if_none_match.empty())
+            request.set(boost::beast::http::field::if_none_match, if_none_match);
+        boost::beast::http::write(socket, request);
+
+        boost::beast::http::response<boost::beast::http::string_body> response;
+        boost::beast::http::read(socket, buffer, response);
+        return response;
+    };
+
+    auto response = kGet("");
+    EXPECT_EQ(response.result(), boost::beast::http::status::ok);
+    EXPECT_EQ(response.body(), "first");
+    EXPECT_EQ(response[boost::beast::http::field::content_type], "text/html; charset=utf-8");
+    const std::string kEtag(response[boost::beast::http::field::etag]);
+    ASSERT_FALSE(kEtag.empty());
+
+    // A matching tag gets the validator without the body
+    response = kGet(kEtag);
+    EXPECT_EQ(response.result(), boost::beast::http::status::not_modified);
+    EXPECT_EQ(response[boost::beast::http::field::etag], kEtag);
+    EXPECT_TRUE(response.body().empty());
+
+    // If-None-Match compares weakly, "*" matches any current page (RFC 7232, 3.2)
+    EXPECT_EQ(kGet("\"other\", " + kEtag).result(), boost::beast::http::status::not_modified);
+    EXPECT_EQ(kGet("W/" + kEtag).result(), boost::beast::http::status::not_modified);
+    EXPECT_EQ(kGet("*").result(), boost::beast::http::status::not_modified);
+
+    response = kGet("\"other\"");
+    EXPECT_EQ(response.result(), boost::beast::http::status::ok);
+    EXPECT_EQ(response.body(), "first");
+    EXPECT_EQ(kGet("W/\"other\"").result(), boost::beast::http::status::ok);
+
+    // A changed file is picked up by the watcher, the old tag gets the new page
+    std::ofstream(kPagesPath / "home" / "index.html") << "second";
+
+    const auto kDeadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    do
+    {
+        response = kGet(kEtag);
+        if (response.result() == boost::beast::http::status::ok)
+            break;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    } while (std::chrono::steady_clock::now() < kDeadline);
+
+    EXPECT_EQ(response.result(), boost::beast::http::status::ok);
+    EXPECT_EQ(response.body(), "second");
+    EXPECT_NE(response[boost::beast::http::field::etag], kEtag);
+
+    server.stop();
+    std::filesystem::remove_all(kPagesPath);
+}
+
+TEST_F(ServerTests, AsyncRoutes)
+{
+    network_module::server::Server::Config config;
+    config.port_ = 18081;
+    config.http_settings_.blocking_threads_number_ = 1;
+
+    network_module::server::Server::Config::Callbacks &callbacks = config.callbacks_;
+
+    network_module::HttpRoute echo_route;
+    echo_route.method_ = "POST";
+    echo_route.pattern_ = "/echo/:id";
+    echo_route.async_callback_ = [](const network_module::HttpRequest &request, network_module::HttpResponder responder)
+    {
+        std::thread([id = std::string(request.get_parameter("id")),
+                     body = std::string(request.body_),
+                     responder = std::move(responder)]()
+                    {
+                        network_module::HttpResponse response;
+                        response.status_ = 201;
+                        response.body_ = id + ":" + body;
+                        responder(std::move(response)); })
+            .detach();
+    };
+    callbacks.http_routes_.push_back(echo_route);
+
+    network_module::HttpRoute blocking_route;
+    blocking_route.pattern_ = "/blocking";
+    blocking_route.callback_ = [](const network_module::HttpRequest &request)
+    { return std::string(request.get_header("x-test")); };
+    blocking_route.is_blocking_ = true;
+    callbacks.http_routes_.push_back(blocking_route);
+
+    network_module::server::Server server;
+    ASSERT_TRUE(server.start(1, config));
+
+    boost::asio::io_context io_context;
+    boost::asio::ip::tcp::socket socket(io_context);
+    socket.connect({boost::asio::ip::make_address(config.host_), static_cast<unsigned short>(config.port_)});
+
+    boost::beast::flat_buffer buffer;
+    boost::beast::http::response<boost::beast::http::string_body> response;
+
+    boost::beast::http::request<boost::beast::http::string_body> echo_request{boost::beast::http::verb::post, "/echo/7", 11};
+    echo_request.body() = "hello";
+    echo_request.prepare_payload();
+    boost::beast::http::write(socket, echo_request);
+    boost::beast::http::read(socket, buffer, response);
+
+    EXPECT_EQ(response.result_int(), 201);
+    EXPECT_EQ(response.body(), "7:hello");
+
+    boost::beast::http::request<boost::beast::http::string_body> blocking_request{boost::beast::http::verb::get, "/blocking", 11};
+    blocking_request.set("X-Test", "header value");
+    boost::beast::http::write(socket, blocking_request);
+    response = {};
+    boost::beast::http::read(socket, buffer, response);
+
+    EXPECT_EQ(response.result_int(), 200);
+    EXPECT_EQ(response.body(), "header value");
+
+    server.stop();
+}
+
+TEST_F(ServerTests, StorageUpload)
+{
+    const auto kStoragePath = std::filesystem::temp_directory_path() / "network_module_tests_storage";
+    std::filesystem::remove_all(kStoragePath);
+
+    network_module::server::Server::Config config;
+    config.port_ = 18082;
+    config.http_settings_.storage_root_path_ = kStoragePath.string();
+    config.http_settings_.max_upload_size_mb_ = 1;
+
+    network_module::server::Server server;
+    ASSERT_TRUE(server.start(1, config));
+
+    boost::asio::io_context io_context;
+    boost::asio::ip::tcp::socket socket(io_context);
+    socket.connect({boost::asio::ip::make_address(config.host_), static_cast<unsigned short>(config.port_)});
+
+    boost::beast::flat_buffer buffer;
+    boost::beast::http::response<boost::beast::http::string_body> response;
+
+    boost::beast::http::request<boost::beast::http::string_body> request{boost::beast::http::verb::put, "/storage/dir/file.txt", 11};
+    request.body() = "123456789";
+    request.chunked(true);
+    boost::beast::http::write(socket, request);
+    boost::beast::http::read(socket, buffer, response);
+
+    EXPECT_EQ(response.result(), boost::beast::http::status::created);
+    EXPECT_EQ(response.body(), "{\"size\":9,\"crc32\":\"cbf43926\"}");
+
+    std::ifstream file(kStoragePath / "dir" / "file.txt");
+    EXPECT_EQ(std::string(std::istreambuf_iterator<char>(file), {}), "123456789");
+
+    request.chunked(false);
+    request.body() = std::string(2 * 1024 * 1024, 'x');
+    request.prepare_payload();
+    boost::beast::http::write(socket, request);
+    response = {};
+    boost::beast::http::read(socket, buffer, response);
+
+    EXPECT_EQ(response.result(), boost::beast::http::status::payload_too_large);
+    EXPECT_FALSE(response.keep_alive());
+
+    server.stop();
+    std::filesystem::remove_all(kStoragePath);
+}
+
+TEST_F(ServerTests, StorageDownload)
+{
+    const auto kStoragePath = std::filesystem::temp_directory_path() / "network_module_tests_download";
+    const auto kSecretPath = std::filesystem::temp_directory_path() / "network_module_tests_secret.txt";
+    std::filesystem::remove_all(kStoragePath);
+    std::filesystem::create_directories(kStoragePath / "dir");
+
+    // Bigger than the socket buffers and than one sendfile round
+    std::string data(16 * 1024 * 1024 + 123, '\0');
+    std::minstd_rand random_engine(42);
+    for (auto &byte : data)
+        byte = static_cast<char>(random_engine());
+
+    std::ofstream(kStoragePath / "big.bin", std::ios::binary) << data;
+    std::ofstream(kSecretPath) << "secret";
+
+    network_module::server::Server::Config config;
+    config.port_ = 18097;
+    config.http_settings_.storage_root_path_ = kStoragePath.string();
+
+    network_module::server::Server server;
+    ASSERT_TRUE(server.start(1, config));
+
+    boost::asio::io_context io_context;
+    boost::asio::ip::tcp::socket socket(io_context);
+    socket.connect({boost::asio::ip::make_address(config.host_), static_cast<unsigned short>(config.port_)});
+    // A small window makes sendfile wait for the socket
+    socket.set_option(boost::asio::socket_base::receive_buffer_size(16 * 1024));
+
+    boost::beast::flat_buffer buffer;
+
+    const auto kGet = [&](const std::string &target, const std::vector<std::pair<boost::beast::http::field, std::string>> &fields)
+    {
+        boost::beast::http::request<boost::beast::http::empty_body> request{boost::beast::http::verb::get, target, 11};
+        for (const auto &kField : fields)
+            request.set(kField.first, kField.second);
+        boost::beast::http::write(socket, request);
+
+        // boost::none disables the limit only for chunked bodies in beast 1.74
+        boost::beast::http::response_parser<boost::beast::http::string_body> parser;
+        parser.body_limit(std::numeric_limits<std::uint64_t>::max());
+        boost::beast::http::read(socket, buffer, parser);
+        return parser.release();
+    };
+
+    // The reader lags behind, the server has to wait for the socket
+    boost::beast::http::request<boost::beast::http::empty_body> big_request{boost::beast::http::verb::get, "/storage/big.bin", 11};
+    boost::beast::http::write(socket, big_request);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    boost::beast::http::response_parser<boost::beast::http::string_body> big_parser;
+    big_parser.body_limit(std::numeric_limits<std::uint64_t>::max());
+    boost::beast::http::read(socket, buffer, big_parser);
+    const auto kBigResponse = big_parser.release();
+
+    EXPECT_EQ(kBigResponse.result(), boost::beast::http::status::ok);
+    EXPECT_TRUE(kBigResponse.body() == data);
+    const std::string kEtag(kBigResponse[boost::beast::http::field::etag]);
+    EXPECT_FALSE(kEtag.empty());
+
+    // Decoded targets can't leave the storage root
+    EXPECT_EQ(kGet("/storage/%2e%2e/network_module_tests_secret.txt", {}).result(), boost::beast::http::status::not_found);
+    EXPECT_EQ(kGet("/storage/dir/..%2f..%2fnetwork_module_tests_secret.txt", {}).result(), boost::beast::http::status::not_found);
+
+    const std::string kSize = std::to_string(data.size());
+
+    auto response = kGet("/storage/big.bin", {{boost::beast::http::field::range, "bytes=10-19"}});
+    EXPECT_EQ(response.result(), boost::beast::http::status::partial_content);
+    EXPECT_EQ(response[boost::beast::http::field::content_range], "bytes 10-19/" + kSize);
+    EXPECT_EQ(response.body(), data.substr(10, 10));
+
+    response = kGet("/storage/big.bin", {{boost::beast::http::field::range, "bytes=0-4,-5"}});
+    EXPECT_EQ(response.result(), boost::beast::http::status::partial_content);
+
+    const std::string kContentType(response[boost::beast::http::field::content_type]);
+    const std::string kBoundaryPrefix{"multipart/byteranges; boundary="};
+    ASSERT_EQ(kContentType.rfind(kBoundaryPrefix, 0), 0);
+    const std::string kBoundary = kContentType.substr(kBoundaryPrefix.size());
+
+    const std::string kLastOffset = std::to_string(data.size() - 5);
+    const std::string kLastByte = std::to_string(data.size() - 1);
+    EXPECT_EQ(response.body(),
+              "--" + kBoundary + "\r\nContent-Type: application/octet-stream\r\nContent-Range: bytes 0-4/" + kSize + "\r\n\r\n" +
+                  data.substr(0, 5) +
+                  "\r\n--" + kBoundary + "\r\nContent-Type: application/octet-stream\r\nContent-Range: bytes " +
+                  kLastOffset + "-" + kLastByte + "/" + kSize + "\r\n\r\n" +
+                  data.substr(data.size() - 5) +
+                  "\r\n--" + kBoundary + "--\r\n");
+
+    response = kGet("/storage/big.bin", {{boost::beast::http::field::range, "bytes=" + kSize + "-"}});
+    EXPECT_EQ(response.result(), boost::beast::http::status::range_not_satisfiable);
+    EXPECT_EQ(response[boost::beast::http::field::content_range], "bytes */" + kSize);
+
+    // A changed validator gets the whole file, the current one gets the range
+    response = kGet("/storage/big.bin", {{boost::beast::http::field::range, "bytes=0-9"},
+                                         {boost::beast::http::field::if_range, "\"other\""}});
+    EXPECT_EQ(response.result(), boost::beast::http::status::ok);
+    EXPECT_TRUE(response.body() == data);
+
+    response = kGet("/storage/big.bin", {{boost::beast::http::field::range, "bytes=0-9"},
+                                         {boost::beast::http::field::if_range, kEtag}});
+    EXPECT_EQ(response.result(), boost::beast::http::status::partial_content);
+    EXPECT_EQ(response.body(), data.substr(0, 10));
+
+    server.stop();
+    std::filesystem::remove_all(kStoragePath);
+    std::filesystem::remove(kSecretPath);
+}
+
+TEST_F(ServerTests, StorageSlowDownload)
+{
+    const auto kStoragePath = std::filesystem::temp_directory_path() / "network_module_tests_slow_download";
+    std::filesystem::remove_all(kStoragePath);
+    std::filesystem::create_directories(kStoragePath);
+
+    std::string data(16 * 1024 * 1024, '\0');
+    std::minstd_rand random_engine(7);
+    for (auto &byte : data)
+        byte = static_cast<char>(random_engine());
+
+    std::ofstream(kStoragePath / "big.bin", std::ios::binary) << data;
+
+    // Every timeout is shorter than reading the file takes
+    network_module::server::Server::Config config;
+    config.port_ = 18101;
+    config.http_settings_.request_timeout_sec_ = 1;
+    config.http_settings_.keep_alive_timeout_sec_ = 1;
+    config.http_settings_.write_timeout_sec_ = 1;
+    config.http_settings_.storage_root_path_ = kStoragePath.string();
+    config.callbacks_.http_callbacks_["/small"] = []()
+    { return "small"; };
+
+    network_module::server::Server server;
+    ASSERT_TRUE(server.start(1, config));
+
+    boost::asio::io_context io_context;
+    boost::asio::ip::tcp::socket socket(io_context);
+    socket.connect({boost::asio::ip::make_address(config.host_), static_cast<unsigned short>(config.port_)});
+
+    boost::beast::flat_buffer buffer;
+    boost::beast::http::response<boost::beast::http::string_body> response;
+
+    boost::asio::write(socket, boost::asio::buffer(std::string{"GET /small HTTP/1.1\r\nHost: localhost\r\n\r\n"}));
+    boost::beast::http::read(socket, buffer, response);
+    EXPECT_EQ(response.body(), "small");
+
+    // The download on the reused connection goes on while bytes are taken
+    boost::asio::write(socket, boost::asio::buffer(std::string{"GET /storage/big.bin HTTP/1.1\r\nHost: localhost\r\n\r\n"}));
+
+    const auto kBegin = std::chrono::steady_clock::now();
+    boost::beast::http::response_parser<boost::beast::http::string_body> parser;
+    ASSERT_TRUE(read_slowly(socket, buffer, parser));
+    EXPECT_GT(std::chrono::steady_clock::now() - kBegin, std::chrono::milliseconds(1500));
+
+    EXPECT_EQ(parser.get().result(), boost::beast::http::status::ok);
+    EXPECT_TRUE(parser.get().body() == data);
+
+    // Resuming an interrupted download is a big range read as slowly
+    const std::uint64_t kResumeOffset = 1000;
+    boost::asio::write(socket, boost::asio::buffer("GET /storage/big.bin HTTP/1.1\r\nHost: localhost\r\nRange: bytes=" +
+                                                   std::to_string(kResumeOffset) + "-\r\n\r\n"));
+
+    boost::beast::http::response_parser<boost::beast::http::string_body> range_parser;
+    ASSERT_TRUE(read_slowly(socket, buffer, range_parser));
+
+    EXPECT_EQ(range_parser.get().result(), boost::beast::http::status::partial_content);
+    EXPECT_EQ(range_parser.get()[boost::beast::http::field::content_range],
+              "bytes " + std::to_string(kResumeOffset) + "-" + std::to_string(data.size() - 1) + "/" + std::to_string(data.size()));
+    EXPECT_TRUE(range_parser.get().body() == data.substr(kResumeOffset));
+
+    // A reader which stops taking bytes is disconnected
+    boost::asio::ip::tcp::socket stalled_socket(io_context);
+    stalled_socket.open(boost::asio::ip::tcp::v4());
+    stalled_socket.set_option(boost::asio::socket_base::receive_buffer_size(16 * 1024));
+    stalled_socket.connect({boost::asio::ip::make_address(config.host_), static_cast<unsigned short>(config.port_)});
+
+    boost::asio::write(stalled_socket, boost::asio::buffer(std::string{"GET /storage/big.bin HTTP/1.1\r\nHost: localhost\r\n\r\n"}));
+    std::this_thread::sleep_for(std::chrono::seconds(3));
+
+    boost::system::error_code error_code;
+    boost::beast::flat_buffer stalled_buffer;
+    boost::beast::http::response_parser<boost::beast::http::string_body> stalled_parser;
+    stalled_parser.body_limit(std::numeric_limits<std::uint64_t>::max());
+    boost::beast::http::read(stalled_socket, stalled_buffer, stalled_parser, error_code);
+    EXPECT_TRUE(error_code);
+
+    server.stop();
+    std::filesystem::remove_all(kStoragePath);
+}
+
+TEST_F(ServerTests, SendQueueOverflow)
+{
+    network_module::server::Server::Config config;
+    config.port_ = 18083;
+    config.web_socket_settings_.max_queue_messages_ = 4;
+    config.web_socket_settings_.max_queue_bytes_ = std::size_t(1) << 30;
+    config.web_socket_settings_.overflow_policy_ = network_module::server::Server::Config::WebSocketSettings::OverflowPolicy::kDropOldest;
+    config.callbacks_.web_sockets_callbacks_.process_new_connection_ = [](const network_module::web_sockets::SessionId &) {};
+    config.callbacks_.web_sockets_callbacks_.process_receiving_ = [](const network_module::web_sockets::SessionId &, const std::string_view &, const bool &) {};
+
+    network_module::server::Server server;
+    ASSERT_TRUE(server.start(1, config));
+
+    boost::asio::io_context io_context;
+    boost::beast::websocket::stream<boost::asio::ip::tcp::socket> client(io_context);
+    client.next_layer().connect({boost::asio::ip::make_address(config.host_), static_cast<unsigned short>(config.port_)});
+    client.handshake(config.host_, "/");
+
+    while (server.get_statistics().sessions_number_ == 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    // The client doesn't read, the first message doesn't fit socket buffers
+    // and stays being written, the rest go to the queue
+    const std::string kMessage(8 * 1024 * 1024, 'x');
+    for (int message_i = 0; message_i < 10; ++message_i)
+        server.send(kMessage);
+
+    // Messages are queued on the session executor
+    auto statistics = server.get_statistics();
+    for (int wait_i = 0; (wait_i < 5000) && (statistics.dropped_messages_ < 5); ++wait_i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        statistics = server.get_statistics();
+    }
+
+    EXPECT_EQ(statistics.queued_messages_, 4);
+    EXPECT_EQ(statistics.queued_bytes_, 4 * kMessage.size());
+    EXPECT_EQ(statistics.dropped_messages_, 5);
+
+    server.stop();
+}
+
+TEST_F(ServerTests, WriteCoalescing)
+{
+    network_module::server::Server::Config config;
+    config.port_ = 18084;
+    config.web_socket_settings_.max_queue_bytes_ = std::size_t(1) << 30;
+    config.web_socket_settings_.is_write_coalescing_ = true;
+    config.callbacks_.web_sockets_callbacks_.process_new_connection_ = [](const network_module::web_sockets::SessionId &) {};
+    config.callbacks_.web_sockets_callbacks_.process_receiving_ = [](const network_module::web_sockets::SessionId &, const std::string_view &, const bool &) {};
+
+    network_module::server::Server server;
+    ASSERT_TRUE(server.start(1, config));
+
+    boost::asio::io_context io_context;
+    boost::beast::websocket::stream<boost::asio::ip::tcp::socket> client(io_context);
+    client.next_layer().connect({boost::asio::ip::make_address(config.host_), static_cast<unsigned short>(config.port_)});
+    client.handshake(config.host_, "/");
+
+    while (server.get_statistics().sessions_number_ == 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    // Messages sent while the big one is being written are merged
+    const std::size_t kMessagesNumber = 100;
+    const std::string kBigMessage(8 * 1024 * 1024, 'x');
+    server.send(kBigMessage);
+    for (std::size_t message_i = 0; message_i < kMessagesNumber; ++message_i)
+        server.send(std::to_string(message_i));
+
+    boost::beast::flat_buffer buffer;
+    client.read(buffer);
+    EXPECT_EQ(buffer.size(), kBigMessage.size());
+    buffer.consume(buffer.size());
+
+    // All of them come in the next frame, the receiver splits it
+    client.read(buffer);
+    const auto kFrame = boost::beast::buffers_to_string(buffer.data());
+
+    std::vector<std::string> messages;
+    for (std::size_t begin = 0; begin <= kFrame.size();)
+    {
+        const auto kEnd = std::min(kFrame.find('\n', begin), kFrame.size());
+        messages.push_back(kFrame.substr(begin, kEnd - begin));
+        begin = kEnd + 1;
+    }
+
+    ASSERT_EQ(messages.size(), kMessagesNumber);
+    for (std::size_t message_i = 0; message_i < kMessagesNumber; ++message_i)
+        EXPECT_EQ(messages[message_i], std::to_string(message_i));
+
+    // Nothing else was written
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(client.next_layer().available(), 0);
+    EXPECT_EQ(server.get_statistics().queued_messages_, 0);
+
+    server.stop();
+}
+
+TEST_F(ServerTests, ConcurrentSend)
+{
+    network_module::server::Server::Config config;
+    config.port_ = 18085;
+    config.io_mode_ = network_module::server::Server::Config::IoMode::kShared;
+    config.web_socket_settings_.max_queue_messages_ = 4096;
+    config.callbacks_.web_sockets_callbacks_.process_new_connection_ = [](const network_module::web_sockets::SessionId &) {};
+    config.callbacks_.web_sockets_callbacks_.process_receiving_ = [](const network_module::web_sockets::SessionId &, const std::string_view &, const bool &) {};
+
+    network_module::server::Server server;
+    ASSERT_TRUE(server.start(4, config));
+
+    boost::asio::io_context io_context;
+    boost::beast::websocket::stream<boost::asio::ip::tcp::socket> client(io_context);
+    client.next_layer().connect({boost::asio::ip::make_address(config.host_), static_cast<unsigned short>(config.port_)});
+    client.handshake(config.host_, "/");
+
+    while (server.get_statistics().sessions_number_ == 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    // Producers broadcast at once while io threads are writing
+    const int kProducersNumber = 4;
+    const int kMessagesNumber = 500;
+
+    std::vector<std::thread> producers;
+    for (int producer_i = 0; producer_i < kProducersNumber; ++producer_i)
+    {
+        producers.emplace_back([&server, producer_i]()
+                               {
+                                   for (int message_i = 0; message_i < kMessagesNumber; ++message_i)
+                                       server.send(std::to_string(producer_i) + ":" + std::to_string(message_i)); });
+    }
+
+    for (auto &producer : producers)
+        producer.join();
+
+    // Every message arrives, in the order of its producer
+    std::vector<int> next_messages(kProducersNumber, 0);
+    boost::beast::flat_buffer buffer;
+    for (int message_i = 0; message_i < kProducersNumber * kMessagesNumber; ++message_i)
+    {
+        client.read(buffer);
+        const auto kMessage = boost::beast::buffers_to_string(buffer.data());
+        buffer.consume(buffer.size());
+
+        const auto kSeparator = kMessage.find(':');
+        ASSERT_NE(kSeparator, std::string::npos);
+
+        const int kProducer = std::stoi(kMessage.substr(0, kSeparator));
+        ASSERT_EQ(std::stoi(kMessage.substr(kSeparator + 1)), next_messages[kProducer]++);
+    }
+
+    EXPECT_EQ(server.get_statistics().dropped_messages_, 0);
+
+    server.stop();
+}
+
+TEST_F(ServerTests, UnfragmentedBroadcast)
+{
+    network_module::server::Server::Config config;
+    config.port_ = 18103;
+    config.callbacks_.web_sockets_callbacks_.process_new_connection_ = [](const network_module::web_sockets::SessionId &) {};
+    config.callbacks_.web_sockets_callbacks_.process_receiving_ = [](const network_module::web_sockets::SessionId &, const std::string_view &, const bool &) {};
+
+    network_module::server::Server server;
+    ASSERT_TRUE(server.start(1, config));
+
+    // Frames are read from the raw socket, a websocket stream would hide their boundaries
+    boost::asio::io_context io_context;
+    boost::asio::ip::tcp::socket socket(io_context);
+    socket.connect({boost::asio::ip::make_address(config.host_), static_cast<unsigned short>(config.port_)});
+
+    boost::asio::write(socket, boost::asio::buffer(std::string{"GET / HTTP/1.1\r\n"
+                                                               "Host: localhost\r\n"
+                                                               "Upgrade: websocket\r\n"
+                                                               "Connection: Upgrade\r\n"
+                                                               "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                                                               "Sec-WebSocket-Version: 13\r\n\r\n"}));
+
+    boost::beast::flat_buffer buffer;
+    boost::beast::http::response<boost::beast::http::empty_body> response;
+    boost::beast::http::read(socket, buffer, response);
+    ASSERT_EQ(response.result(), boost::beast::http::status::switching_protocols);
+
+    while (server.get_statistics().sessions_number_ == 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    // Much bigger than the write buffer of beast streams
+    std::string message(1024 * 1024 + 1, '\0');
+    for (std::size_t byte_i = 0; byte_i < message.size(); ++byte_i)
+        message[byte_i] = static_cast<char>('a' + byte_i % 26);
+    EXPECT_TRUE(server.send(message));
+
+    const auto kRead = [&](const std::size_t &size)
+    {
+        while (buffer.size() < size)
+            buffer.commit(socket.read_some(buffer.prepare(64 * 1024)));
+    };
+
+    // One final text frame, not masked, with a 64-bit length
+    kRead(10);
+    const auto *kHeader = static_cast<const unsigned char *>(buffer.data().data());
+    EXPECT_EQ(kHeader[0], 0x81);
+    EXPECT_EQ(kHeader[1], 127);
+
+    std::uint64_t payload_size = 0;
+    for (std::size_t byte_i = 2; byte_i < 10; ++byte_i)
+        payload_size = (payload_size << 8) | kHeader[byte_i];
+    EXPECT_EQ(payload_size, message.size());
+    buffer.consume(10);
+
+    kRead(message.size());
+    EXPECT_TRUE(std::string(static_cast<const char *>(buffer.data().data()), message.size()) == message);
+
+    server.stop();
+}
+
+TEST_F(ServerTests, BinaryReceiving)
+{
+    std::mutex mutex;
+    std::vector<std::pair<std::string, bool>> received;
+
+    network_module::server::Server::Config config;
+    config.port_ = 18104;
+    config.callbacks_.web_sockets_callbacks_.process_new_connection_ = [](const network_module::web_sockets::SessionId &) {};
+    config.callbacks_.web_sockets_callbacks_.process_receiving_ = [&](const network_module::web_sockets::SessionId &, const std::string_view &data, const bool &is_binary)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        received.emplace_back(data, is_binary);
+    };
+
+    network_module::server::Server server;
+    ASSERT_TRUE(server.start(1, config));
+
+    boost::asio::io_context io_context;
+    boost::beast::websocket::stream<boost::asio::ip::tcp::socket> client(io_context);
+    client.next_layer().connect({boost::asio::ip::make_address(config.host_), static_cast<unsigned short>(config.port_)});
+    client.handshake(config.host_, "/");
+
+    // Zero and high bytes aren't valid utf-8 text, they come through as they are
+    const std::string kBinary{'\0', '\x01', '\xff', '\xfe', '\0', 'x'};
+    client.binary(true);
+    client.write(boost::asio::buffer(kBinary));
+
+    client.text(true);
+    client.write(boost::asio::buffer(std::string{"text"}));
+
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (received.size() >= 2)
+                break;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ASSERT_EQ(received.size(), 2);
+        EXPECT_EQ(received[0].first, kBinary);
+        EXPECT_TRUE(received[0].second);
+        EXPECT_EQ(received[1].first, "text");
+        EXPECT_FALSE(received[1].second);
+    }
+
+    server.stop();
+}
+
+TEST_F(ServerTests, BroadcastDuringReconnects)
+{
+    const std::size_t kStableNumber = 4;
+    const std::size_t kChangingThreadsNumber = 4;
+    const std::size_t kMessagesNumber = 2000;
+
+    network_module::server::Server::Config config;
+    config.port_ = 18102;
+    config.web_socket_settings_.max_queue_messages_ = kMessagesNumber;
+    config.callbacks_.web_sockets_callbacks_.process_new_connection_ = [](const network_module::web_sockets::SessionId &) {};
+    config.callbacks_.web_sockets_callbacks_.process_receiving_ = [](const network_module::web_sockets::SessionId &, const std::string_view &, const bool &) {};
+
+    network_module::server::Server server;
+    ASSERT_TRUE(server.start(4, config));
+
+    const boost::asio::ip::tcp::endpoint kEndpoint{boost::asio::ip::make_address(config.host_), static_cast<unsigned short>(config.port_)};
+
+    boost::asio::io_context io_context;
+    std::vector<std::unique_ptr<boost::beast::websocket::stream<boost::asio::ip::tcp::socket>>> stable_clients;
+    for (std::size_t client_i = 0; client_i < kStableNumber; ++client_i)
+    {
+        stable_clients.push_back(std::make_unique<boost::beast::websocket::stream<boost::asio::ip::tcp::socket>>(io_context));
+        stable_clients.back()->next_layer().connect(kEndpoint);
+        stable_clients.back()->handshake(config.host_, "/");
+    }
+
+    while (server.get_statistics().sessions_number_ < kStableNumber)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    // Other clients connect and disconnect from several threads while broadcasting
+    std::atomic<bool> is_changing{true};
+    std::atomic<std::size_t> changes_number{0};
+
+    std::vector<std::thread> changing_threads;
+    for (std::size_t thread_i = 0; thread_i < kChangingThreadsNumber; ++thread_i)
+    {
+        changing_threads.emplace_back([&]()
+                                      {
+                                          boost::asio::io_context thread_io_context;
+                                          while (is_changing)
+                                          {
+                                              boost::beast::websocket::stream<boost::asio::ip::tcp::socket> client(thread_io_context);
+                                              boost::system::error_code error_code;
+                                              client.next_layer().connect(kEndpoint, error_code);
+                                              if (!error_code)
+                                                  client.handshake(config.host_, "/", error_code);
+                                              if (!error_code)
+                                                  ++changes_number;
+                                          } });
+    }
+
+    // Every stable client gets every broadcast, in order
+    std::vector<std::thread> reading_threads;
+    std::vector<std::size_t> received_numbers(kStableNumber, 0);
+    for (std::size_t client_i = 0; client_i < kStableNumber; ++client_i)
+    {
+        reading_threads.emplace_back([&, client_i]()
+                                     {
+                                         boost::beast::flat_buffer buffer;
+                                         for (std::size_t message_i = 0; message_i < kMessagesNumber; ++message_i)
+                                         {
+                                             boost::system::error_code error_code;
+                                             stable_clients[client_i]->read(buffer, error_code);
+                                             if (error_code || (boost::beast::buffers_to_string(buffer.data()) != std::to_string(message_i)))
+                                                 return;
+
+                                             buffer.consume(buffer.size());
+                                             received_numbers[client_i] = message_i + 1;
+                                         } });
+    }
+
+    for (std::size_t message_i = 0; message_i < kMessagesNumber; ++message_i)
+    {
+        EXPECT_TRUE(server.send(std::to_string(message_i)));
+        if (message_i % 50 == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    for (auto &thread : reading_threads)
+        thread.join();
+
+    is_changing = false;
+    for (auto &thread : changing_threads)
+        thread.join();
+
+    for (const auto &kReceivedNumber : received_numbers)
+        EXPECT_EQ(kReceivedNumber, kMessagesNumber);
+    EXPECT_GT(changes_number, 0);
+
+    // Sessions of the closed clients are released
+    const auto kDeadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while ((server.get_statistics().sessions_number_ > kStableNumber) && (std::chrono::steady_clock::now() < kDeadline))
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_EQ(server.get_statistics().sessions_number_, kStableNumber);
+
+    server.stop();
+}
+
+TEST_F(ServerTests, TopicsPublish)
+{
+    std::atomic<int> received_number{0};
+
+    network_module::server::Server::Config config;
+    config.port_ = 18086;
+    config.web_socket_settings_.is_topics_enabled_ = true;
+    config.callbacks_.web_sockets_callbacks_.process_new_connection_ = [](const network_module::web_sockets::SessionId &) {};
+    config.callbacks_.web_sockets_callbacks_.process_receiving_ = [&received_number](const network_module::web_sockets::SessionId &, const std::string_view &data, const bool &)
+    {
+        EXPECT_EQ(data, "ping");
+        ++received_number;
+    };
+
+    network_module::server::Server server;
+    ASSERT_TRUE(server.start(1, config));
+
+    boost::asio::io_context io_context;
+    std::vector<std::unique_ptr<boost::beast::websocket::stream<boost::asio::ip::tcp::socket>>> clients;
+    for (const std::string kTopic : {"news", "weather"})
+    {
+        clients.emplace_back(std::make_unique<boost::beast::websocket::stream<boost::asio::ip::tcp::socket>>(io_context));
+        clients.back()->next_layer().connect({boost::asio::ip::make_address(config.host_), static_cast<unsigned short>(config.port_)});
+        clients.back()->handshake(config.host_, "/");
+
+        // A session handles its messages in order, the subscription
+        // is done when the message after it is received
+        clients.back()->write(boost::asio::buffer("{\"subscribe\": \"" + kTopic + "\"}"));
+        clients.back()->write(boost::asio::buffer(std::string("ping")));
+    }
+
+    while (received_number != 2)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    EXPECT_TRUE(server.publish("news", "1"));
+    EXPECT_TRUE(server.publish("weather", "2"));
+    EXPECT_FALSE(server.publish("sport", "3"));
+
+    boost::beast::flat_buffer buffer;
+    clients[0]->read(buffer);
+    EXPECT_EQ(boost::beast::buffers_to_string(buffer.data()), "1");
+    buffer.consume(buffer.size());
+
+    clients[1]->read(buffer);
+    EXPECT_EQ(boost::beast::buffers_to_string(buffer.data()), "2");
+    buffer.consume(buffer.size());
+
+    clients[0]->write(boost::asio::buffer(std::string("{\"unsubscribe\": \"news\"}")));
+    clients[0]->write(boost::asio::buffer(std::string("ping")));
+
+    while (received_number != 3)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    EXPECT_FALSE(server.publish("news", "4"));
+
+    server.stop();
+}
+
+TEST_F(ServerTests, SendToSessions)
+{
+    std::mutex mutex;
+    std::vector<network_module::web_sockets::SessionId> sessions_ids;
+    std::vector<network_module::web_sockets::SessionId> senders_ids;
+    std::vector<std::pair<std::string, bool>> messages;
+
+    network_module::server::Server::Config config;
+    config.port_ = 18087;
+    config.callbacks_.web_sockets_callbacks_.process_new_connection_ = [&](const network_module::web_sockets::SessionId &session_id)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        sessions_ids.push_back(session_id);
+    };
+    config.callbacks_.web_sockets_callbacks_.process_receiving_ = [&](const network_module::web_sockets::SessionId &session_id, const std::string_view &data, const bool &is_binary)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        senders_ids.push_back(session_id);
+        messages.emplace_back(data, is_binary);
+    };
+
+    network_module::server::Server server;
+    ASSERT_TRUE(server.start(1, config));
+
+    const auto kWaitFor = [&mutex](const std::vector<network_module::web_sockets::SessionId> &ids, const std::size_t &size)
+    {
+        while (true)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (ids.size() == size)
+                    return;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    };
+
+    boost::asio::io_context io_context;
+    std::vector<std::unique_ptr<boost::beast::websocket::stream<boost::asio::ip::tcp::socket>>> clients;
+    for (std::size_t client_i = 0; client_i < 2; ++client_i)
+    {
+        clients.emplace_back(std::make_unique<boost::beast::websocket::stream<boost::asio::ip::tcp::socket>>(io_context));
+        clients.back()->next_layer().connect({boost::asio::ip::make_address(config.host_), static_cast<unsigned short>(config.port_)});
+        clients.back()->handshake(config.host_, "/");
+
+        kWaitFor(sessions_ids, client_i + 1);
+    }
+
+    ASSERT_NE(sessions_ids[0], sessions_ids[1]);
+
+    clients[1]->write(boost::asio::buffer(std::string("hello")));
+    clients[1]->binary(true);
+    clients[1]->write(boost::asio::buffer(std::string("\x00\x01", 2)));
+    kWaitFor(senders_ids, 2);
+    EXPECT_EQ(senders_ids[0], sessions_ids[1]);
+    EXPECT_EQ(messages[0], std::make_pair(std::string("hello"), false));
+    EXPECT_EQ(messages[1], std::make_pair(std::string("\x00\x01", 2), true));
+
+    EXPECT_TRUE(server.send_to(sessions_ids[1], "1"));
+    EXPECT_EQ(server.send_to(std::vector<network_module::web_sockets::SessionId>{sessions_ids[0], sessions_ids[1], 0}, "2"), 2);
+    EXPECT_FALSE(server.send_to(0, "3"));
+
+    boost::beast::flat_buffer buffer;
+    clients[0]->read(buffer);
+    EXPECT_EQ(boost::beast::buffers_to_string(buffer.data()), "2");
+    buffer.consume(buffer.size());
+
+    for (const std::string kExpected : {"1", "2"})
+    {
+        clients[1]->read(buffer);
+        EXPECT_EQ(boost::beast::buffers_to_string(buffer.data()), kExpected);
+        buffer.consume(buffer.size());
+    }
+
+    server.stop();
+}
+
+TEST_F(ServerTests, ReceivingPool)
+{
+    std::mutex mutex;
+    std::vector<std::string> messages;
+    std::promise<void> unblock;
+    auto unblocked = unblock.get_future().share();
+
+    network_module::server::Server::Config config;
+    config.port_ = 18088;
+    config.web_socket_settings_.receiving_threads_number_ = 2;
+    config.web_socket_settings_.max_receiving_queue_messages_ = 2;
+    config.callbacks_.web_sockets_callbacks_.process_new_connection_ = [](const network_module::web_sockets::SessionId &) {};
+    config.callbacks_.web_sockets_callbacks_.process_receiving_ = [&](const network_module::web_sockets::SessionId &, const std::string_view &data, const bool &)
+    {
+        if (data == "slow")
+            unblocked.wait();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        messages.emplace_back(data);
+    };
+
+    // One io thread, the slow message must not hold it
+    network_module::server::Server server;
+    ASSERT_TRUE(server.start(1, config));
+
+    boost::asio::io_context io_context;
+    std::vector<std::unique_ptr<boost::beast::websocket::stream<boost::asio::ip::tcp::socket>>> clients;
+    for (std::size_t client_i = 0; client_i < 2; ++client_i)
+    {
+        clients.emplace_back(std::make_unique<boost::beast::websocket::stream<boost::asio::ip::tcp::socket>>(io_context));
+        clients.back()->next_layer().connect({boost::asio::ip::make_address(config.host_), static_cast<unsigned short>(config.port_)});
+        clients.back()->handshake(config.host_, "/");
+    }
+
+    const auto kWaitFor = [&](const std::size_t &size)
+    {
+        while (true)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (messages.size() == size)
+                    return;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    };
+
+    clients[0]->write(boost::asio::buffer(std::string("slow")));
+    for (int message_i = 0; message_i < 5; ++message_i)
+        clients[0]->write(boost::asio::buffer(std::to_string(message_i)));
+
+    clients[1]->write(boost::asio::buffer(std::string("fast")));
+    kWaitFor(1);
+    EXPECT_EQ(messages[0], "fast");
+
+    // Messages of a session keep their order after reading is resumed
+    unblock.set_value();
+    kWaitFor(7);
+    EXPECT_EQ(messages, (std::vector<std::string>{"fast", "slow", "0", "1", "2", "3", "4"}));
+
+    server.stop();
+}
+
+TEST_F(ServerTests, Compression)
+{
+    std::promise<std::string> received;
+
+    network_module::server::Server::Config config;
+    config.port_ = 18089;
+    config.web_socket_settings_.compression_.is_enabled_ = true;
+    config.web_socket_settings_.compression_.max_window_bits_ = 10;
+    config.web_socket_settings_.compression_.is_context_takeover_ = false;
+    config.callbacks_.web_sockets_callbacks_.process_new_connection_ = [](const network_module::web_sockets::SessionId &) {};
+    config.callbacks_.web_sockets_callbacks_.process_receiving_ = [&received](const network_module::web_sockets::SessionId &, const std::string_view &data, const bool &)
+    { received.set_value(std::string(data)); };
+
+    network_module::server::Server server;
+    ASSERT_TRUE(server.start(1, config));
+
+    boost::asio::io_context io_context;
+    boost::beast::websocket::stream<boost::asio::ip::tcp::socket> client(io_context);
+
+    boost::beast::websocket::permessage_deflate option;
+    option.client_enable = true;
+    client.set_option(option);
+
+    client.next_layer().connect({boost::asio::ip::make_address(config.host_), static_cast<unsigned short>(config.port_)});
+
+    boost::beast::websocket::response_type response;
+    client.handshake(response, config.host_, "/");
+    EXPECT_NE(response[boost::beast::http::field::sec_websocket_extensions].find("permessage-deflate"), boost::beast::string_view::npos);
+
+    std::string message;
+    for (int line_i = 0; line_i < 1000; ++line_i)
+        message += "{\"line\": " + std::to_string(line_i) + "}\n";
+
+    client.write(boost::asio::buffer(message));
+    EXPECT_EQ(received.get_future().get(), message);
+
+    server.send(message);
+
+    boost::beast::flat_buffer buffer;
+    client.read(buffer);
+    EXPECT_EQ(boost::beast::buffers_to_string(buffer.data()), message);
+
+    server.stop();
+}
+
+TEST_F(ServerTests, InvalidCompressionSettings)
+{
+    const std::string kConfigPath{(std::filesystem::temp_directory_path() / "network_module_invalid_compression.json").string()};
+
+    {
+        std::ofstream config_file(kConfigPath);
+        config_file << R"({"host": "127.0.0.1", "port": 18095, "reconnect_timeout_sec": 1, "workers_number": 1,
+                          "compression_enabled": true, "compression_max_window_bits": 20})";
+    }
+
+    // Beast would throw from the first websocket session
+    EXPECT_THROW(network_module::server::Server::Config::load_config(kConfigPath), std::runtime_error);
+    EXPECT_THROW(network_module::client::Client::Config::load_config(kConfigPath), std::runtime_error);
+    std::filesystem::remove(kConfigPath);
+
+    network_module::server::Server::Config server_config;
+    server_config.port_ = 18095;
+    server_config.web_socket_settings_.compression_.memory_level_ = 0;
+
+    network_module::server::Server server;
+    EXPECT_FALSE(server.start(1, server_config));
+
+    network_module::client::Client::Config client_config;
+    client_config.port_ = 18095;
+    client_config.compression_.level_ = 10;
+
+    network_module::client::Client client;
+    EXPECT_FALSE(client.start(client_config));
+}
+
+TEST_F(ServerTests, DeadPeersEviction)
+{
+    network_module::server::Server::Config config;
+    config.port_ = 18090;
+    config.http_settings_.request_timeout_sec_ = 1;
+    config.web_socket_settings_.ping_interval_sec_ = 1;
+    config.callbacks_.web_sockets_callbacks_.process_new_connection_ = [](const network_module::web_sockets::SessionId &) {};
+    config.callbacks_.web_sockets_callbacks_.process_receiving_ = [](const network_module::web_sockets::SessionId &, const std::string_view &, const bool &) {};
+
+    network_module::server::Server server;
+    ASSERT_TRUE(server.start(1, config));
+
+    const boost::asio::ip::tcp::endpoint kEndpoint{boost::asio::ip::make_address(config.host_), static_cast<unsigned short>(config.port_)};
+    boost::asio::io_context io_context;
+
+    // A connection without a request is closed by its deadline
+    boost::asio::ip::tcp::socket silent_socket(io_context);
+    silent_socket.connect(kEndpoint);
+
+    char byte;
+    boost::system::error_code error_code;
+    silent_socket.read_some(boost::asio::buffer(&byte, 1), error_code);
+    EXPECT_EQ(error_code, boost::asio::error::eof);
+
+    // A websocket client which never reads doesn't answer pings
+    boost::beast::websocket::stream<boost::asio::ip::tcp::socket> client(io_context);
+    client.next_layer().connect(kEndpoint);
+    client.handshake(config.host_, "/");
+
+    while (server.get_statistics().sessions_number_ == 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    const auto kStart = std::chrono::steady_clock::now();
+    while ((server.get_statistics().sessions_number_ != 0) &&
+           (std::chrono::steady_clock::now() - kStart < std::chrono::seconds(10)))
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    EXPECT_EQ(server.get_statistics().sessions_number_, 0);
+
+    server.stop();
+}
+
+TEST(ClientTests, ConnectionsPool)
+{
+    std::mutex mutex;
+    std::map<network_module::web_sockets::SessionId, std::size_t> messages_per_session;
+    std::atomic<std::size_t> messages_number{0};
+
+    network_module::server::Server::Config server_config;
+    server_config.port_ = 18091;
+    server_config.callbacks_.web_sockets_callbacks_.process_new_connection_ = [](const network_module::web_sockets::SessionId &) {};
+    server_config.callbacks_.web_sockets_callbacks_.process_receiving_ = [&](const network_module::web_sockets::SessionId &session_id, const std::string_view &, const bool &)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++messages_per_session[session_id];
+        ++messages_number;
+    };
+
+    network_module::server::Server server;
+    ASSERT_TRUE(server.start(1, server_config));
+
+    std::atomic<std::size_t> started_number{0};
+    std::atomic<std::size_t> received_number{0};
+
+    network_module::client::Client::Config client_config;
+    client_config.port_ = server_config.port_;
+    client_config.workers_number_ = 2;
+    client_config.connections_number_ = 4;
+    client_config.balancing_ = network_module::client::Client::Config::Balancing::kRoundRobin;
+    client_config.callbacks_.on_start_ = [&started_number]()
+    { ++started_number; };
+    client_config.callbacks_.process_receiving_ = [&received_number](const std::string_view &, const bool &)
+    { ++received_number; };
+
+    network_module::client::Client client;
+    ASSERT_TRUE(client.start(client_config));
+
+    while (started_number < 4)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    EXPECT_EQ(client.get_connected_number(), 4);
+
+    for (std::size_t message_i = 0; message_i < 40; ++message_i)
+        EXPECT_TRUE(client.send(std::to_string(message_i)));
+
+    while (messages_number < 40)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ASSERT_EQ(messages_per_session.size(), 4);
+        for (const auto &kSession : messages_per_session)
+            EXPECT_EQ(kSession.second, 10);
+    }
+
+    EXPECT_TRUE(server.send("all"));
+    while (received_number < 4)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    client.stop();
+    EXPECT_FALSE(client.is_running());
+    EXPECT_FALSE(client.send("after stop"));
+
+    server.stop();
+}
+
+TEST(ClientTests, ReconnectBackoff)
+{
+    network_module::client::Client::Config client_config;
+    client_config.port_ = 18092;
+    client_config.reconnect_initial_delay_ms_ = 20;
+    client_config.reconnect_timeout_sec_ = 1;
+    client_config.callbacks_.on_start_ = []() {};
+    client_config.callbacks_.process_receiving_ = [](const std::string_view &, const bool &) {};
+
+    // The server isn't there yet, the connection keeps retrying with growing delays
+    network_module::client::Client client;
+    ASSERT_TRUE(client.start(client_config));
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    EXPECT_EQ(client.get_connected_number(), 0);
+
+    network_module::server::Server::Config server_config;
+    server_config.port_ = client_config.port_;
+    server_config.callbacks_.web_sockets_callbacks_.process_new_connection_ = [](const network_module::web_sockets::SessionId &) {};
+    server_config.callbacks_.web_sockets_callbacks_.process_receiving_ = [](const network_module::web_sockets::SessionId &, const std::string_view &, const bool &) {};
+
+    network_module::server::Server server;
+    ASSERT_TRUE(server.start(1, server_config));
+
+    // Capped by reconnect_timeout_sec_, not waiting for it after every failure
+    const auto kStart = std::chrono::steady_clock::now();
+    while (client.get_connected_number() == 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    EXPECT_LE(std::chrono::steady_clock::now() - kStart, std::chrono::milliseconds(1500));
+
+    // The same connection comes back after the server restarts
+    server.stop();
+    while (client.get_connected_number() != 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    ASSERT_TRUE(server.start(1, server_config));
+    while (client.get_connected_number() == 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    EXPECT_TRUE(client.send("back"));
+
+    client.stop();
+    server.stop();
+}
+
+TEST(ClientTests, ConcurrentSend)
+{
+    const std::size_t kThreadsNumber = 4;
+    const std::size_t kMessagesNumber = 250;
+
+    std::mutex mutex;
+    std::vector<std::vector<std::size_t>> received(kThreadsNumber);
+    std::atomic<std::size_t> received_number{0};
+
+    network_module::server::Server::Config server_config;
+    server_config.port_ = 18093;
+    server_config.callbacks_.web_sockets_callbacks_.process_new_connection_ = [](const network_module::web_sockets::SessionId &) {};
+    server_config.callbacks_.web_sockets_callbacks_.process_receiving_ = [&](const network_module::web_sockets::SessionId &, const std::string_view &data, const bool &)
+    {
+        const auto kColon = data.find(':');
+        std::lock_guard<std::mutex> lock(mutex);
+        received[std::stoul(std::string(data.substr(0, kColon)))].push_back(std::stoul(std::string(data.substr(kColon + 1))));
+        ++received_number;
+    };
+
+    network_module::server::Server server;
+    ASSERT_TRUE(server.start(1, server_config));
+
+    network_module::client::Client::Config client_config;
+    client_config.port_ = server_config.port_;
+    client_config.workers_number_ = 2;
+    client_config.callbacks_.on_start_ = []() {};
+    client_config.callbacks_.process_receiving_ = [](const std::string_view &, const bool &) {};
+
+    network_module::client::Client client;
+    ASSERT_TRUE(client.start(client_config));
+
+    while (client.get_connected_number() == 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    std::vector<std::thread> senders;
+    for (std::size_t thread_i = 0; thread_i < kThreadsNumber; ++thread_i)
+    {
+        senders.emplace_back([&client, thread_i, kMessagesNumber]()
+                             {
+                                 for (std::size_t message_i = 0; message_i < kMessagesNumber; ++message_i)
+                                     EXPECT_TRUE(client.send(std::to_string(thread_i) + ":" + std::to_string(message_i))); });
+    }
+    for (auto &sender : senders)
+        sender.join();
+
+    while (received_number < kThreadsNumber * kMessagesNumber)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    // Every message arrives once, in the order of its thread
+    for (const auto &kThreadMessages : received)
+    {
+        ASSERT_EQ(kThreadMessages.size(), kMessagesNumber);
+        for (std::size_t message_i = 0; message_i < kMessagesNumber; ++message_i)
+            EXPECT_EQ(kThreadMessages[message_i], message_i);
+    }
+
+    client.stop();
+    server.stop();
+}
+
+TEST(ClientTests, SendStress)
+{
+    const std::size_t kThreadsNumber = 8;
+    const std::size_t kMessagesNumber = 5000;
+
+    std::mutex mutex;
+    std::vector<std::vector<std::size_t>> received(kThreadsNumber);
+    std::atomic<std::size_t> received_number{0};
+
+    network_module::server::Server::Config server_config;
+    server_config.port_ = 18105;
+    server_config.callbacks_.web_sockets_callbacks_.process_new_connection_ = [](const network_module::web_sockets::SessionId &) {};
+    server_config.callbacks_.web_sockets_callbacks_.process_receiving_ = [&](const network_module::web_sockets::SessionId &, const std::string_view &data, const bool &)
+    {
+        const auto kColon = data.find(':');
+        std::lock_guard<std::mutex> lock(mutex);
+        received[std::stoul(std::string(data.substr(0, kColon)))].push_back(std::stoul(std::string(data.substr(kColon + 1))));
+        ++received_number;
+    };
+
+    network_module::server::Server server;
+    ASSERT_TRUE(server.start(2, server_config));
+
+    // Senders outpace the writer, messages queued meanwhile are written as batches of frames
+    network_module::client::Client::Config client_config;
+    client_config.port_ = server_config.port_;
+    client_config.workers_number_ = 4;
+    client_config.callbacks_.on_start_ = []() {};
+    client_config.callbacks_.process_receiving_ = [](const std::string_view &, const bool &) {};
+
+    network_module::client::Client client;
+    ASSERT_TRUE(client.start(client_config));
+
+    while (client.get_connected_number() == 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    std::vector<std::thread> senders;
+    for (std::size_t thread_i = 0; thread_i < kThreadsNumber; ++thread_i)
+    {
+        senders.emplace_back([&client, thread_i, kMessagesNumber]()
+                             {
+                                 for (std::size_t message_i = 0; message_i < kMessagesNumber; ++message_i)
+                                     EXPECT_TRUE(client.send(std::to_string(thread_i) + ":" + std::to_string(message_i))); });
+    }
+    for (auto &sender : senders)
+        sender.join();
+
+    while (received_number < kThreadsNumber * kMessagesNumber)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    // Nothing is sent twice
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(received_number, kThreadsNumber * kMessagesNumber);
+
+    // Every message arrives once, in the order of its thread
+    for (const auto &kThreadMessages : received)
+    {
+        ASSERT_EQ(kThreadMessages.size(), kMessagesNumber);
+        for (std::size_t message_i = 0; message_i < kMessagesNumber; ++message_i)
+            EXPECT_EQ(kThreadMessages[message_i], message_i);
+    }
+
+    client.stop();
+    server.stop();
+}
+
+TEST(ClientTests, OfflineSpool)
+{
+    const auto kSpoolPath = std::filesystem::temp_directory_path() / "network_module_tests_spool";
+    std::filesystem::remove(kSpoolPath);
+
+    network_module::client::Client::Config client_config;
+    client_config.port_ = 18094;
+    client_config.reconnect_initial_delay_ms_ = 20;
+    client_config.reconnect_timeout_sec_ = 1;
+    client_config.spool_path_ = kSpoolPath.string();
+    client_config.max_spool_size_mb_ = 1;
+    client_config.callbacks_.on_start_ = []() {};
+    client_config.callbacks_.process_receiving_ = [](const std::string_view &, const bool &) {};
+
+    // Nobody listens, messages go to the spool and stay there after stopping
+    {
+        network_module::client::Client client;
+        ASSERT_TRUE(client.start(client_config));
+        for (std::size_t message_i = 0; message_i < 20; ++message_i)
+            EXPECT_TRUE(client.send(std::to_string(message_i)));
+        client.stop();
+    }
+
+    std::mutex mutex;
+    std::vector<std::string> messages;
+
+    network_module::server::Server::Config server_config;
+    server_config.port_ = client_config.port_;
+    server_config.callbacks_.web_sockets_callbacks_.process_new_connection_ = [](const network_module::web_sockets::SessionId &) {};
+    server_config.callbacks_.web_sockets_callbacks_.process_receiving_ = [&](const network_module::web_sockets::SessionId &, const std::string_view &data, const bool &)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        messages.emplace_back(data);
+    };
+
+    network_module::server::Server server;
+    ASSERT_TRUE(server.start(1, server_config));
+
+    // The next client replays them before new ones
+    network_module::client::Client client;
+    ASSERT_TRUE(client.start(client_config));
+    EXPECT_TRUE(client.send("new"));
+
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (messages.size() >= 21)
+                break;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ASSERT_EQ(messages.size(), 21);
+        for (std::size_t message_i = 0; message_i < 20; ++message_i)
+            EXPECT_EQ(messages[message_i], std::to_string(message_i));
+        EXPECT_EQ(messages[20], "new");
+    }
+
+    client.stop();
+    server.stop();
+    std::filesystem::remove(kSpoolPath);
+}
+
+TEST(ClientTests, SpoolOnConnectionLoss)
+{
+    const auto kSpoolPath = std::filesystem::temp_directory_path() / "network_module_tests_spool_loss";
+    std::filesystem::remove(kSpoolPath);
+
+    network_module::client::Client::Config client_config;
+    client_config.port_ = 18098;
+    client_config.reconnect_initial_delay_ms_ = 20;
+    client_config.reconnect_timeout_sec_ = 1;
+    client_config.spool_path_ = kSpoolPath.string();
+    client_config.max_spool_size_mb_ = 4;
+    client_config.callbacks_.on_start_ = []() {};
+    client_config.callbacks_.process_receiving_ = [](const std::string_view &, const bool &) {};
+
+    std::mutex mutex;
+    std::set<std::string> received;
+
+    network_module::server::Server::Config server_config;
+    server_config.port_ = client_config.port_;
+    server_config.callbacks_.web_sockets_callbacks_.process_new_connection_ = [](const network_module::web_sockets::SessionId &) {};
+    server_config.callbacks_.web_sockets_callbacks_.process_receiving_ = [&](const network_module::web_sockets::SessionId &, const std::string_view &data, const bool &)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        received.emplace(data);
+    };
+
+    auto server = std::make_unique<network_module::server::Server>();
+    ASSERT_TRUE(server->start(1, server_config));
+
+    network_module::client::Client client;
+    ASSERT_TRUE(client.start(client_config));
+
+    while (client.get_connected_number() == 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    // The server goes away mid-stream, messages written to the lost connection
+    // and the ones sent meanwhile come after it is back, duplicates are allowed
+    const std::size_t kMessagesNumber = 20000;
+    std::vector<std::string> accepted;
+
+    for (std::size_t message_i = 0; message_i < kMessagesNumber; ++message_i)
+    {
+        if (message_i == kMessagesNumber / 4)
+        {
+            server->stop();
+            server.reset();
+        }
+        else if (message_i == kMessagesNumber / 2)
+        {
+            server = std::make_unique<network_module::server::Server>();
+            ASSERT_TRUE(server->start(1, server_config));
+        }
+
+        const std::string kMessage = std::to_string(message_i);
+        if (client.send(kMessage))
+            accepted.push_back(kMessage);
+
+        if (message_i % 100 == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    EXPECT_EQ(accepted.size(), kMessagesNumber);
+
+    const auto kDeadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+    std::size_t missing_number = accepted.size();
+
+    while (std::chrono::steady_clock::now() < kDeadline)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            missing_number = std::count_if(accepted.begin(), accepted.end(),
+                                           [&](const std::string &message)
+                                           {
+                                               return received.count(message) == 0;
+                                           });
+        }
+
+        if (missing_number == 0)
+            break;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    EXPECT_EQ(missing_number, 0);
+
+    client.stop();
+    server->stop();
+    std::filesystem::remove(kSpoolPath);
+}
+
+TEST(SessionsManagerTests, ReleaseAfterRemove)
+{
+    boost::asio::io_context io_context;
+    TimerWheel timer_wheel;
+    const auto kContext = std::make_shared<const SessionContext>(network_module::server::Server::Config(), nullptr, nullptr);
+
+    SessionsManager sessions_manager;
+
+    auto session = std::make_shared<WebSocketSession>(boost::asio::ip::tcp::socket(io_context), sessions_manager, timer_wheel, kContext);
+    const std::weak_ptr<WebSocketSession> kWeakSession = session;
+
+    ASSERT_TRUE(sessions_manager.add(session));
+    EXPECT_TRUE(sessions_manager.send("message", std::string()));
+
+    // Sending to a not accepted session fails and leaves nothing pending
+    io_context.run();
+
+    sessions_manager.remove(kWeakSession.lock()->get_id());
+    session.reset();
+
+    // No broadcast has to come to release the session
+    EXPECT_TRUE(kWeakSession.expired());
+    EXPECT_EQ(sessions_manager.get_statistics().sessions_number_, 0);
+    EXPECT_FALSE(sessions_manager.send("message", std::string()));
+}
+
+TEST(SessionsManagerTests, ConcurrentChanges)
+{
+    const std::size_t kChangesNumber{2000};
+    const std::size_t kKeptNumber{100};
+
+    boost::asio::io_context io_context;
+    auto work_guard = boost::asio::make_work_guard(io_context);
+    std::thread io_thread([&]()
+                          { io_context.run(); });
+
+    TimerWheel timer_wheel;
+    const auto kContext = std::make_shared<const SessionContext>(network_module::server::Server::Config(), nullptr, nullptr);
+
+    SessionsManager sessions_manager;
+
+    const auto kMakeSession = [&]()
+    {
+        return std::make_shared<WebSocketSession>(boost::asio::ip::tcp::socket(io_context), sessions_manager, timer_wheel, kContext);
+    };
+
+    std::vector<std::weak_ptr<WebSocketSession>> sessions;
+    std::vector<network_module::web_sockets::SessionId> kept_ids;
+    for (std::size_t session_i = 0; session_i < kKeptNumber; ++session_i)
+    {
+        const auto kSession = kMakeSession();
+        ASSERT_TRUE(sessions_manager.add(kSession));
+        sessions.push_back(kSession);
+        kept_ids.push_back(kSession->get_id());
+    }
+
+    std::atomic<bool> is_changing{true};
+
+    std::thread broadcasting_thread([&]()
+                                    {
+                                        while (is_changing)
+                                            sessions_manager.send("message", std::string()); });
+
+    // Connects and disconnects go on while broadcasting
+    std::vector<std::weak_ptr<WebSocketSession>> changed_sessions;
+    for (std::size_t change_i = 0; change_i < kChangesNumber; ++change_i)
+    {
+        const auto kSession = kMakeSession();
+        ASSERT_TRUE(sessions_manager.add(kSession));
+        sessions_manager.remove(kSession->get_id());
+        changed_sessions.push_back(kSession);
+    }
+
+    is_changing = false;
+    broadcasting_thread.join();
+
+    EXPECT_EQ(sessions_manager.get_statistics().sessions_number_, kKeptNumber);
+
+    for (const auto &kSessionId : kept_ids)
+        sessions_manager.remove(kSessionId);
+
+    EXPECT_EQ(sessions_manager.get_statistics().sessions_number_, 0);
+
+    // Messages posted by broadcasts are the only owners left
+    work_guard.reset();
+    io_thread.join();
+
+    for (const auto &kSession : sessions)
+        EXPECT_TRUE(kSession.expired());
+    for (const auto &kSession : changed_sessions)
+        EXPECT_TRUE(kSession.expired());
+}
+
+TEST(TimerWheelTests, Expiry)
+{
+    boost::asio::io_context io_context;
+
+    // A revolution is 80 ms, longer deadlines wait for their round
+    TimerWheel timer_wheel(std::chrono::milliseconds(10), 8);
+    timer_wheel.start(io_context);
+
+    std::vector<std::string> expired;
+    TimerWheel::Timer short_timer(timer_wheel);
+    TimerWheel::Timer long_timer(timer_wheel);
+    TimerWheel::Timer cancelled_timer(timer_wheel);
+
+    short_timer.set_handler([&expired](const std::uint64_t &)
+                            { expired.push_back("short"); });
+    long_timer.set_handler([&expired, &long_timer](const std::uint64_t &generation)
+                           {
+                               EXPECT_TRUE(long_timer.is_expired(generation));
+                               expired.push_back("long"); });
+    cancelled_timer.set_handler([&expired](const std::uint64_t &)
+                                { expired.push_back("cancelled"); });
+
+    const auto kStart = std::chrono::steady_clock::now();
+
+    long_timer.expires_after(std::chrono::milliseconds(200));
+    short_timer.expires_after(std::chrono::milliseconds(30));
+    cancelled_timer.expires_after(std::chrono::milliseconds(20));
+    cancelled_timer.cancel();
+
+    while (expired.size() < 2)
+        io_context.run_one();
+
+    EXPECT_GE(std::chrono::steady_clock::now() - kStart, std::chrono::milliseconds(200));
+    EXPECT_EQ(expired, (std::vector<std::string>{"short", "long"}));
+
+    timer_wheel.stop();
+}
+
+TEST(HttpRangesTests, Parse)
+{
+    std::vector<HttpRanges::ByteRange> ranges;
+
+    EXPECT_TRUE(HttpRanges::parse("bytes=0-499", 1000, ranges));
+    EXPECT_EQ(ranges, (std::vector<HttpRanges::ByteRange>{{0, 500}}));
+
+    EXPECT_TRUE(HttpRanges::parse("bytes=500-, -100", 1000, ranges));
+    EXPECT_EQ(ranges, (std::vector<HttpRanges::ByteRange>{{500, 500}}));
+
+    EXPECT_TRUE(HttpRanges::parse("bytes=900-1999,0-0", 1000, ranges));
+    EXPECT_EQ(ranges, (std::vector<HttpRanges::ByteRange>{{900, 100}, {0, 1}}));
+
+    EXPECT_TRUE(HttpRanges::parse("bytes=-2000", 1000, ranges));
+    EXPECT_EQ(ranges, (std::vector<HttpRanges::ByteRange>{{0, 1000}}));
+
+    EXPECT_TRUE(HttpRanges::parse("bytes=1000-", 1000, ranges));
+    EXPECT_TRUE(ranges.empty());
+
+    EXPECT_FALSE(HttpRanges::parse("bytes=5-1", 1000, ranges));
+    EXPECT_FALSE(HttpRanges::parse("items=0-1", 1000, ranges));
+    EXPECT_FALSE(HttpRanges::parse("bytes=a-b", 1000, ranges));
+
+    EXPECT_EQ(HttpRanges::to_content_range({0, 500}, 1000), "bytes 0-499/1000");
+}
+
+TEST(RouterTests, Find)
+{
+    network_module::server::Server::Config::Callbacks callbacks;
+    callbacks.http_callbacks_["/"] = []()
+    { return "home"; };
+    callbacks.http_callbacks_[network_module::Urls::kPageNotFound_] = []()
+    { return "not found"; };
+    callbacks.http_routes_.push_back({"GET", "/users/:id", [](const network_module::HttpRequest &request)
+                                      { return "user " + std::string(request.get_parameter("id")); }, {}, false});
+    callbacks.http_routes_.push_back({"GET", "/users/me", [](const network_module::HttpRequest &)
+                                      { return "me"; }, {}, false});
+    callbacks.http_routes_.push_back({"POST", "/users/:id", [](const network_module::HttpRequest &)
+                                      { return "updated"; }, {}, false});
+    callbacks.http_routes_.push_back({"GET", "/files/*", [](const network_module::HttpRequest &request)
+                                      { return std::string(request.get_parameter("*")); }, {}, false});
+
+    const Router kRouter(callbacks);
+
+    network_module::HttpRequest request;
+    const Router::Handler *handler = nullptr;
+
+    ASSERT_EQ(kRouter.find(boost::beast::http::verb::get, "/", request.parameters_, handler), Router::Status::kFound);
+    EXPECT_EQ(handler->callback_(), "home");
+
+    ASSERT_EQ(kRouter.find(boost::beast::http::verb::get, "/users/42", request.parameters_, handler), Router::Status::kFound);
+    EXPECT_EQ(handler->request_callback_(request), "user 42");
+
+    ASSERT_EQ(kRouter.find(boost::beast::http::verb::get, "/users/me", request.parameters_, handler), Router::Status::kFound);
+    EXPECT_EQ(handler->request_callback_(request), "me");
+
+    ASSERT_EQ(kRouter.find(boost::beast::http::verb::get, "//users//me", request.parameters_, handler), Router::Status::kFound);
+    EXPECT_EQ(handler->request_callback_(request), "me");
+
+    ASSERT_EQ(kRouter.find(boost::beast::http::verb::post, "/users/me", request.parameters_, handler), Router::Status::kFound);
+    EXPECT_EQ(handler->request_callback_(request), "updated");
+
+    ASSERT_EQ(kRouter.find(boost::beast::http::verb::get, "/files/a/b.txt", request.parameters_, handler), Router::Status::kFound);
+    EXPECT_EQ(handler->request_callback_(request), "a/b.txt");
+
+    EXPECT_EQ(kRouter.find(boost::beast::http::verb::delete_, "/users/42", request.parameters_, handler), Router::Status::kMethodNotAllowed);
+    EXPECT_EQ(kRouter.get_allowed_methods("/users/42"), "GET, POST");
+
+    EXPECT_EQ(kRouter.find(boost::beast::http::verb::get, "/nothing", request.parameters_, handler), Router::Status::kNotFound);
+    ASSERT_NE(kRouter.get_not_found_handler(), nullptr);
+    EXPECT_EQ(kRouter.get_not_found_handler()->callback_(), "not found");
+}
+
+TEST(HdrHistogramTests, Percentiles)
+{
+    const std::int64_t kMaxValue = 1000000;
+
+    HdrHistogram histogram(kMaxValue, 3);
+    for (std::int64_t value = 1; value <= kMaxValue; ++value)
+        histogram.record(value);
+
+    EXPECT_EQ(histogram.get_total_count(), kMaxValue);
+    EXPECT_EQ(histogram.get_min(), 1);
+    EXPECT_EQ(histogram.get_max(), kMaxValue);
+    EXPECT_DOUBLE_EQ(histogram.get_mean(), (kMaxValue + 1) / 2.0);
+
+    // Three significant figures, a value is off by a thousandth of it at most
+    for (const double kPercentile : {50.0, 99.0, 99.9})
+    {
+        const auto kExpected = static_cast<std::int64_t>(kPercentile / 100 * kMaxValue);
+        const auto kValue = histogram.get_value_at_percentile(kPercentile);
+
+        EXPECT_GE(kValue, kExpected) << kPercentile;
+        EXPECT_LE(kValue, kExpected + kExpected / 1000) << kPercentile;
+    }
+
+    EXPECT_EQ(histogram.get_value_at_percentile(100), kMaxValue);
+
+    // Small values are kept exactly
+    HdrHistogram small_values(kMaxValue, 3);
+    for (std::int64_t value = 1; value <= 1000; ++value)
+        small_values.record(value);
+
+    EXPECT_EQ(small_values.get_value_at_percentile(50), 500);
+    EXPECT_EQ(small_values.get_value_at_percentile(99), 990);
+    EXPECT_EQ(small_values.get_value_at_percentile(99.9), 999);
+}
+
+TEST(HdrHistogramTests, AddAndReset)
+{
+    const std::int64_t kMaxValue = 1000000;
+    const auto kExpectSame = [](const HdrHistogram &histogram, const HdrHistogram &expected)
+    {
+        EXPECT_EQ(histogram.get_total_count(), expected.get_total_count());
+        EXPECT_EQ(histogram.get_min(), expected.get_min());
+        EXPECT_EQ(histogram.get_max(), expected.get_max());
+        EXPECT_DOUBLE_EQ(histogram.get_mean(), expected.get_mean());
+
+        for (const double kPercentile : {0.0, 10.0, 50.0, 90.0, 99.0, 99.9, 100.0})
+            EXPECT_EQ(histogram.get_value_at_percentile(kPercentile), expected.get_value_at_percentile(kPercentile)) << kPercentile;
+    };
+
+    HdrHistogram all(kMaxValue);
+    HdrHistogram odd(kMaxValue);
+    HdrHistogram even(kMaxValue);
+    for (std::int64_t value = 1; value <= kMaxValue; ++value)
+    {
+        all.record(value);
+        (value % 2 ? odd : even).record(value);
+    }
+
+    // Histograms of threads are merged into the one of the report
+    HdrHistogram merged(kMaxValue);
+    merged.add(odd);
+    merged.add(even);
+    kExpectSame(merged, all);
+
+    // A reset one is as a new one, the next interval doesn't see the previous
+    merged.reset();
+    EXPECT_EQ(merged.get_total_count(), 0);
+    EXPECT_EQ(merged.get_value_at_percentile(50), 0);
+
+    merged.add(odd);
+    kExpectSame(merged, odd);
+
+    merged.reset();
+    for (std::int64_t value = 1; value <= kMaxValue; ++value)
+        merged.record(value);
+    kExpectSame(merged, all);
 }